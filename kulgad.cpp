@@ -13,105 +13,2838 @@
 //         -lboost_system -lpthread
 // ------------------------------------------------------------------------------------------------------
 // Build: g++ -std=c++17 -O2 kulgad.cpp -o kulgad-cli -lboost_system -lpthread
+//        (-mavx2 또는 -march=native 를 추가하면 pins 디코더가 AVX2 경로를 사용)
 // Run  :
 //   ./kulgad-cli -s -on 100-231
 //   ./kulgad-cli 10,2,3 -s -on
 //   ./kulgad-cli 12,3,15 -off -s
 //   ./kulgad-cli -g all
 //   ./kulgad-cli -g 2-20
+//   ./kulgad-cli -s -on all --no-batch   (서버가 batch를 지원해도 채널별 전송)
+//   ./kulgad-cli -s -off 0-63 --no-batch --rate 200 --burst 8 --ack --window 16
+//   ./kulgad-cli --daemon &              (연결 유지. 이후 실행은 Unix 소켓으로 데몬에 전달)
+//   ./kulgad-cli --watch 0-63 --interval 500ms   (바뀐 채널만 타임스탬프와 함께 출력)
+//   ./kulgad-cli --watch all --interval 10ms --binary   (상태 35바이트 bitmap, JSON 은 ~1.5KB)
+//   ./kulgad-cli -g all --target rack1:3001 --target rack2:3001 --targets fleet.txt --threads 4
+//   ./kulgad-cli -s -on 100-231 --diff --cache-ttl 5s   (이미 on 인 채널은 보내지 않음)
+//   ./kulgad-cli -s -on 0-63 --verify --verify-retries 3   (다시 읽어 확인, 다른 채널만 재전송)
+//   ./kulgad-cli -g all --connect-timeout 500ms --io-timeout 1s --retries 3   (종료 코드 4=시간 초과, 5=거부)
+//   ./kulgad-cli -g all --stats --stats-prom /var/lib/node_exporter/kulgad.prom
+//   ./kulgad-cli --seq "pulse 5 200ms; stagger 1-64 on 10ms at 1s; chase 100-107 50ms every 400ms times 5"
+//   ./kulgad-cli -s -on 2:0-15,700-800 --channels 1024   (bank 별 프레임을 한 연결로 연달아 전송)
+//   ./kulgad-cli --script seq.txt        (한 연결에서 "set 1-16 on" / "get all" / "sleep 200ms" 순차 실행)
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
 #include <boost/asio/connect.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <algorithm>
+#include <array>
 #include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace beast = boost::beast;
 namespace websocket = beast::websocket;
 namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
+namespace local = boost::asio::local;
+using ws_stream = websocket::stream<beast::tcp_stream>;
+
+// 종료 코드: 0=성공, 1=일반 오류, 3=--verify 후에도 불일치, 4=시간 초과, 5=연결 거부
+static constexpr int kExitMismatch = 3, kExitTimeout = 4, kExitRefused = 5;
+
+static int exit_code_for(const beast::error_code& ec){
+    if(ec==beast::error::timeout) return kExitTimeout;
+    if(ec==net::error::connection_refused) return kExitRefused;
+    return 1;
+}
+
+// 이후 비동기 read/write/connect 의 제한 시간. 0 이면 무제한.
+static void arm_timeout(ws_stream& ws, std::chrono::steady_clock::duration d){
+    if(d.count()>0) beast::get_lowest_layer(ws).expires_after(d);
+    else beast::get_lowest_layer(ws).expires_never();
+}
 
 static std::string lower_copy(std::string s){
     for(char& c: s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
     return s;
 }
-static bool is_all_digits(const std::string& s){
-    if(s.empty()) return false;
-    return std::all_of(s.begin(), s.end(), [](unsigned char c){ return std::isdigit(c)!=0; });
+static bool parse_number(const std::string& opt, const char* text, double& out){
+    try{
+        size_t used=0;
+        out = std::stod(text, &used);
+        if(text[used]=='\0' && out>=0) return true;
+    }catch(const std::exception&){}
+    std::cerr << "Invalid value for " << opt << ": " << text << "\n";
+    return false;
+}
+
+// 호출한 사용자 소유의 일반 파일만 읽는다 (심볼릭 링크는 따라가지 않음)
+static bool read_own_file(const std::string& path, std::string& out){
+    int fd = ::open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if(fd<0) return false;
+    struct stat st{};
+    bool ok = ::fstat(fd, &st)==0 && S_ISREG(st.st_mode) && st.st_uid==::getuid();
+    out.clear();
+    char buf[4096];
+    while(ok){
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if(n<0 && errno==EINTR) continue;
+        if(n<=0){ ok = n==0; break; }
+        out.append(buf, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    return ok;
+}
+
+// 읽는 쪽이 쓰다 만 파일을 보지 않도록 임시 파일에 쓰고 rename.
+// 임시 파일은 mkstemp 로 매번 새 이름을 만들므로(O_CREAT|O_EXCL) 동시에 쓰는 스레드/프로세스가 겹치지 않고,
+// 미리 심어 둔 심볼릭 링크를 따라가지도 않는다.
+static bool write_file_atomic(const std::string& path, const std::string& body, mode_t mode = 0644){
+    std::string tmp = path + ".XXXXXX";
+    int fd = ::mkstemp(&tmp[0]);
+    if(fd<0) return false;
+    bool ok = ::fchmod(fd, mode)==0;
+    for(size_t off=0; ok && off<body.size();){
+        ssize_t n = ::write(fd, body.data()+off, body.size()-off);
+        if(n<0 && errno==EINTR) continue;
+        ok = n>0;
+        if(ok) off += static_cast<size_t>(n);
+    }
+    ok = (::close(fd)==0) && ok;
+    if(ok && std::rename(tmp.c_str(), path.c_str())==0) return true;
+    ::unlink(tmp.c_str());
+    return false;
+}
+
+static void usage(){
+    std::cerr
+      << "Usage:\n"
+      << "  kulgad-cli [options] [channels]\n"
+      << "Options:\n"
+      << "  -s | --set        : set 모드 (채널 상태 변경)\n"
+      << "  -g | --get        : get 모드 (상태 조회)\n"
+      << "  -on | --on        : set 값 true\n"
+      << "  -off| --off       : set 값 false\n"
+      << "  --no-batch        : batch set 미사용 (채널별 1프레임)\n"
+      << "  --rate R          : 초당 최대 set 프레임 수 (기본 20, 0=무제한)\n"
+      << "  --burst B         : 연속 전송 허용 프레임 수 (기본 1)\n"
+      << "  --ack             : 프레임별 응답({\"ok\":...}) 대기\n"
+      << "  --window N        : --ack 시 응답 대기 중 최대 프레임 수 (기본 8)\n"
+      << "  --binary          : 바이너리 프로토콜(kulgad.bin.v1) 제안, 서버가 거절하면 JSON\n"
+      << "  --channels N      : 컨트롤러 채널 수 (기본: 핸드셰이크 X-Kulgad-Caps 의 channels=N, 없으면 256)\n"
+      << "  -w | --watch      : 연결 유지, 바뀐 채널만 출력 (채널 생략 시 all, Ctrl-C로 종료)\n"
+      << "  --interval D      : --watch 폴링 주기 (기본 1s, 0=서버 push만 수신. 예: 200ms, 2s)\n"
+      << "  --seq PATTERN     : 시간 시퀀스 실행 (@FILE 이면 파일에서). 단계는 ';' 로 구분:\n"
+      << "                      set CH on|off / pulse CH W / stagger CH on|off STEP / chase CH STEP [width W]\n"
+      << "                      + at T, every P times N. 같은 tick 의 이벤트는 한 번에 전송, 끝에 지터 보고\n"
+      << "  --tick D          : --seq 시간 해상도 (기본 1ms)\n"
+      << "  --script FILE     : 파일의 명령을 한 연결에서 순서대로 실행 (결과는 명령당 한 줄)\n"
+      << "  --stdin           : --script 와 같되 표준입력에서 읽음\n"
+      << "  --target H:P      : 접속 대상 (반복 가능, 기본 localhost:3001). 여러 개면 동시에 요청\n"
+      << "  --targets FILE    : 대상 목록 파일 (한 줄에 host:port)\n"
+      << "  --threads N       : 여러 대상 처리용 I/O 스레드 수 (기본 min(대상 수, CPU 수))\n"
+      << "  --timeout D       : 여러 대상일 때 대상별 전체 제한 시간, 데몬 경유 시 응답 제한 시간 (기본 10s)\n"
+      << "                      (데몬에 요청을 못 넘기면 직접 연결, 넘긴 뒤 실행이 시작되지 않으면 종료 코드 4)\n"
+      << "  --connect-timeout D: resolve/endpoint 별 connect 제한 시간 (기본 3s, 0=무제한)\n"
+      << "  --io-timeout D    : handshake/응답 대기/전송 제한 시간 (기본 5s, 0=무제한)\n"
+      << "  --retries N       : 모든 endpoint 연결 실패 시 재시도 횟수 (기본 2)\n"
+      << "  --retry-backoff D : 첫 재시도 전 대기, 이후 2배, ±50% 지터 (기본 100ms)\n"
+      << "  --diff            : 현재 상태(get 또는 캐시)와 비교해 바뀌어야 하는 채널만 set\n"
+      << "  --cache-ttl D     : --diff 스냅샷 캐시 유효 시간 (기본 0=항상 get)\n"
+      << "  --cache FILE      : --diff 스냅샷 캐시 파일, 대상 하나일 때만 (기본 $XDG_RUNTIME_DIR/kulgad-<host>_<port>.pins, 없으면 /tmp/kulgad-<uid>-...)\n"
+      << "  --verify          : set 후 get 한 번으로 확인, 다른 채널만 재전송 (끝까지 다르면 종료 코드 3)\n"
+      << "  --verify-retries N: --verify 재전송 횟수 (기본 2)\n"
+      << "  --verify-backoff D: 첫 재전송 전 대기, 이후 매번 2배 (기본 50ms)\n"
+      << "  --stats           : 단계별(resolve/connect/handshake/write/read/close/rtt) 시간 요약을 stderr 로\n"
+      << "  --stats-json FILE : 계측 결과를 JSON 파일로\n"
+      << "  --stats-prom FILE : 계측 결과를 Prometheus textfile 형식으로 (node_exporter 용)\n"
+      << "                      (계측 시에는 데몬을 거치지 않고 직접 연결)\n"
+      << "  --daemon          : 컨트롤러 연결을 유지하는 데몬으로 실행 (Unix 소켓 대기)\n"
+      << "  --socket PATH     : 데몬 소켓 경로 (기본 $KULGAD_SOCKET, $XDG_RUNTIME_DIR/kulgad-cli.sock)\n"
+      << "  --direct          : 데몬이 있어도 직접 연결\n"
+      << "                      (데몬 경유 시 --no-batch/--rate/--ack 등은 데몬 실행 옵션을 따름.\n"
+      << "                       --verify/--diff/--binary/--channels 를 주면 데몬을 거치지 않고 직접 연결)\n"
+      << "Channels:\n"
+      << "  all | A-B | A,B,C | 혼합 가능. (예: 1,2,3,7-9)\n"
+      << "  256채널을 넘으면 256개씩 bank: 전역 번호(700-800) 또는 bank:채널(2:0-15, 3:all)\n"
+      << "Exit codes:\n"
+      << "  0 성공, 1 오류, 3 --verify 불일치, 4 시간 초과, 5 연결 거부\n";
+}
+
+// 256채널 비트마스크. 채널 ch 는 w[ch>>6] 의 (ch&63) 비트.
+// 파싱/set/get/출력이 모두 이 타입을 공유하며, 정렬·중복 제거가 필요 없고 할당도 없다.
+struct ChannelSet{
+    static constexpr int kChannels = 256;
+    static constexpr int kWords = kChannels/64;
+    std::array<std::uint64_t, kWords> w{};
+
+    void set(int ch){ w[ch>>6] |= std::uint64_t(1) << (ch&63); }
+    bool test(int ch) const { return (w[ch>>6] >> (ch&63)) & 1; }
+
+    // a..b (포함) 를 워드 단위로 채운다
+    void set_range(int a, int b){
+        for(int i=a>>6; i<=(b>>6); ++i){
+            std::uint64_t m = ~std::uint64_t(0);
+            if(i==(a>>6)) m &= ~std::uint64_t(0) << (a&63);
+            if(i==(b>>6)) m &= ~std::uint64_t(0) >> (63-(b&63));
+            w[i] |= m;
+        }
+    }
+    static ChannelSet first_n(int n){
+        ChannelSet s;
+        if(n>0) s.set_range(0, std::min(n, kChannels)-1);
+        return s;
+    }
+
+    int count() const {
+        int n=0;
+        for(auto x: w) n += __builtin_popcountll(x);
+        return n;
+    }
+    bool empty() const {
+        for(auto x: w) if(x) return false;
+        return true;
+    }
+
+    // 오름차순으로 켜진 채널마다 f(ch)
+    template<class F> void for_each(F&& f) const {
+        for(int i=0;i<kWords;++i){
+            for(std::uint64_t x=w[i]; x; x&=x-1) f(i*64 + __builtin_ctzll(x));
+        }
+    }
+    // 연속 구간마다 f(a, b)
+    template<class F> void for_each_range(F&& f) const {
+        int start=-1, prev=-2;
+        for_each([&](int ch){
+            if(ch!=prev+1){ if(start>=0) f(start, prev); start=ch; }
+            prev=ch;
+        });
+        if(start>=0) f(start, prev);
+    }
+
+    ChannelSet& operator|=(const ChannelSet& o){ for(int i=0;i<kWords;++i) w[i] |= o.w[i]; return *this; }
+    ChannelSet& operator&=(const ChannelSet& o){ for(int i=0;i<kWords;++i) w[i] &= o.w[i]; return *this; }
+    ChannelSet& operator^=(const ChannelSet& o){ for(int i=0;i<kWords;++i) w[i] ^= o.w[i]; return *this; }
+    friend ChannelSet operator|(ChannelSet a, const ChannelSet& b){ return a |= b; }
+    friend ChannelSet operator&(ChannelSet a, const ChannelSet& b){ return a &= b; }
+    friend ChannelSet operator^(ChannelSet a, const ChannelSet& b){ return a ^= b; }
+    friend ChannelSet operator~(ChannelSet a){ for(auto& x: a.w) x = ~x; return a; }
+    friend bool operator==(const ChannelSet& a, const ChannelSet& b){ return a.w==b.w; }
+};
+
+// 컨트롤러가 보고한 핀 상태 (bank 하나). size 이상 채널은 n/a.
+struct Pins{
+    ChannelSet on;
+    int size=0;
+    int bank=0;
+};
+using BankPins = std::map<int, Pins>;   // bank → 상태
+
+// 256채널을 넘는 컨트롤러는 채널을 256개씩 bank 로 나눈다. 전역 채널 = bank*256 + bank 안 채널.
+// bank 마다 프레임이 따로 오가므로 프로토콜/디코더는 ChannelSet 하나 단위 그대로 쓴다.
+static constexpr int kBankChannels = ChannelSet::kChannels;
+static constexpr int kMaxChannels = 256*kBankChannels;
+
+// 채널 선택. 정렬·병합된 닫힌 구간 목록이라 파싱/중복 제거/전송 비용이 채널 수가 아니라 구간 수에 비례한다.
+// "all" 은 채널 수를 알기 전이라 끝을 kOpen 으로 두고, 연결 후 clamp() 로 컨트롤러 채널 수에 맞춘다.
+class ChannelRanges{
+public:
+    static constexpr int kOpen = std::numeric_limits<int>::max();
+
+    // a..b (포함) 추가. 겹치거나 맞닿은 구간과 합친다.
+    void add(int a, int b){
+        if(a>b) std::swap(a,b);
+        if(b!=kOpen) named_ = std::max(named_, b);
+        auto it = std::lower_bound(r_.begin(), r_.end(), a,
+                                   [](const Range& x, int v){ return x.second < v-1; });
+        auto last = it;
+        for(; last!=r_.end() && last->first-1<=b; ++last){
+            a = std::min(a, last->first);
+            b = std::max(b, last->second);
+        }
+        r_.insert(r_.erase(it, last), Range{a, b});
+    }
+    void add(const ChannelRanges& o){
+        for(auto& x: o.r_) add(x.first, x.second);
+        named_ = std::max(named_, o.named_);
+    }
+    void add_bank(int bank, const ChannelSet& chs){
+        chs.for_each_range([&](int a, int b){ add(bank*kBankChannels+a, bank*kBankChannels+b); });
+    }
+    void subtract(const ChannelRanges& o){
+        std::vector<Range> out;
+        auto j = o.r_.begin();
+        for(Range x: r_){
+            while(j!=o.r_.end() && j->second<x.first) ++j;
+            for(auto k=j; k!=o.r_.end() && k->first<=x.second; ++k){
+                if(k->first>x.first) out.push_back({x.first, k->first-1});
+                if(k->second>=x.second){ x.second = x.first-1; break; }
+                x.first = k->second+1;
+            }
+            if(x.first<=x.second) out.push_back(x);
+        }
+        r_.swap(out);
+    }
+
+    bool empty() const { return r_.empty(); }
+    long long count() const {
+        long long n=0;
+        for(auto& x: r_) n += static_cast<long long>(x.second) - x.first + 1;
+        return n;
+    }
+    int max() const { return r_.empty() ? -1 : r_.back().second; }
+
+    template<class F> void for_each_range(F&& f) const { for(auto& x: r_) f(x.first, x.second); }
+    template<class F> void for_each(F&& f) const {
+        for(auto& x: r_) for(int ch=x.first;; ++ch){ f(ch); if(ch==x.second) break; }
+    }
+
+    // bank b 에 걸친 부분 (bank 안 채널 번호)
+    ChannelSet bank(int b) const {
+        ChannelSet s;
+        const int lo = b*kBankChannels, hi = lo+kBankChannels-1;
+        auto it = std::lower_bound(r_.begin(), r_.end(), lo,
+                                   [](const Range& x, int v){ return x.second < v; });
+        for(; it!=r_.end() && it->first<=hi; ++it)
+            s.set_range(std::max(it->first, lo)-lo, std::min(it->second, hi)-lo);
+        return s;
+    }
+    // 선택이 걸친 bank 마다 오름차순으로 f(bank, 그 bank 의 ChannelSet). clamp() 뒤에만 쓴다.
+    template<class F> void for_each_bank(F&& f) const {
+        int done = -1;
+        for(auto& x: r_){
+            for(int b=std::max(done+1, x.first/kBankChannels); b<=x.second/kBankChannels; ++b){
+                f(b, bank(b));
+                done = b;
+            }
+        }
+    }
+    int banks() const {
+        int n=0;
+        for_each_bank([&](int, const ChannelSet&){ ++n; });
+        return n;
+    }
+
+    // 컨트롤러 채널 수 n 에 맞춘다. "all" 의 열린 끝은 잘라내고, 명시한 채널이 n 이상이면 false.
+    // ("all,1500" 처럼 열린 구간에 합쳐진 채널도 named_ 로 잡는다)
+    bool clamp(int n, std::ostream& err){
+        if(named_>=n){
+            err << "Channel out of range: " << named_ << " (controller has " << n << " channels)\n";
+            return false;
+        }
+        while(!r_.empty() && r_.back().second==kOpen){
+            if(r_.back().first<n){ r_.back().second = n-1; break; }
+            r_.pop_back();
+        }
+        if(!r_.empty() && r_.back().second>=n){
+            err << "Channel out of range: " << r_.back().second << " (controller has " << n << " channels)\n";
+            return false;
+        }
+        return true;
+    }
+
+    friend bool operator==(const ChannelRanges& a, const ChannelRanges& b){ return a.r_==b.r_; }
+
+private:
+    using Range = std::pair<int,int>;
+    std::vector<Range> r_;
+    int named_ = -1;    // 명시한 채널 중 가장 큰 번호 ("all" 의 열린 끝 제외)
+};
+
+// 10진 숫자열 → 정수 (값이 너무 크면 kMaxChannels 로 포화)
+static bool parse_uint(const char* p, const char* end, int& v){
+    if(p==end) return false;
+    v=0;
+    for(; p<end; ++p){
+        if(*p<'0' || *p>'9') return false;
+        if(v<kMaxChannels) v = v*10 + (*p-'0');
+    }
+    return true;
+}
+
+// 원소는 쉼표로 구분: all | A | A-B (전역 번호) 또는 B:all | B:A | B:A-C (bank B 안 0..255)
+static bool parse_channels_token(const std::string& token, ChannelRanges& out,
+                                 std::ostream& err = std::cerr){
+    if(token.empty()){ err<<"Empty channel token.\n"; return false; }
+    const char* p = token.data();
+    const char* end = p + token.size();
+    for(;;){
+        const char* comma = std::find(p, end, ',');
+        if(p==comma){ err<<"Invalid channel list near ','\n"; return false; }
+        const char* elem = p;
+        int base = 0, limit = kMaxChannels;
+        const char* colon = std::find(p, comma, ':');
+        if(colon!=comma){
+            int bank;
+            if(!parse_uint(p, colon, bank) || bank>=kMaxChannels/kBankChannels){
+                err<<"Invalid bank: "; err.write(elem, comma-elem)<<"\n"; return false;
+            }
+            base = bank*kBankChannels;
+            limit = kBankChannels;
+            p = colon+1;
+        }
+        const char* dash = std::find(p, comma, '-');
+        if(beast::iequals(beast::string_view(p, comma-p), "all")){
+            out.add(base, colon!=comma ? base+kBankChannels-1 : ChannelRanges::kOpen);
+        }else if(dash==comma){
+            int ch;
+            if(!parse_uint(p, comma, ch)){ err<<"Invalid channel: "; err.write(elem, comma-elem)<<"\n"; return false; }
+            if(ch>=limit){ err<<"Channel out of range: "; err.write(elem, comma-elem)<<"\n"; return false; }
+            out.add(base+ch, base+ch);
+        }else{
+            int a, b;
+            if(!parse_uint(p, dash, a) || !parse_uint(dash+1, comma, b)){
+                err<<"Invalid range: "; err.write(elem, comma-elem)<<"\n"; return false;
+            }
+            if(std::max(a,b)>=limit){ err<<"Range out of bounds: "; err.write(elem, comma-elem)<<"\n"; return false; }
+            out.add(base+a, base+b);
+        }
+        if(comma==end) break;
+        p = comma + 1;
+    }
+    return true;
+}
+
+// "1-3,7,9-12" 형태의 압축 표기
+template<class Set>
+static std::string format_channels(const Set& chs){
+    std::string out;
+    chs.for_each_range([&](int a, int b){
+        if(!out.empty()) out += ',';
+        if(b==ChannelRanges::kOpen){ out += "all"; return; }    // clamp() 전의 "all"
+        out += std::to_string(a);
+        if(b>a) out += '-' + std::to_string(b);
+    });
+    return out;
+}
+
+// 핸드셰이크 응답의 X-Kulgad-Caps 헤더 (예: "batch, channels=1024") 의 토큰마다 f(tok)
+template<class F>
+static void for_each_cap(beast::string_view caps, F&& f){
+    while(!caps.empty()){
+        auto comma = caps.find(',');
+        auto tok = caps.substr(0, comma);
+        while(!tok.empty() && tok.front()==' ') tok.remove_prefix(1);
+        while(!tok.empty() && tok.back()==' ')  tok.remove_suffix(1);
+        f(tok);
+        if(comma==beast::string_view::npos) break;
+        caps.remove_prefix(comma+1);
+    }
+}
+
+static bool has_cap(beast::string_view caps, beast::string_view want){
+    bool found = false;
+    for_each_cap(caps, [&](beast::string_view tok){ found = found || beast::iequals(tok, want); });
+    return found;
+}
+
+// "key=N" 토큰의 N. 없거나 숫자가 아니면 -1.
+static int cap_value(beast::string_view caps, beast::string_view key){
+    int v = -1;
+    for_each_cap(caps, [&](beast::string_view tok){
+        if(tok.size()>key.size() && tok[key.size()]=='=' && beast::iequals(tok.substr(0, key.size()), key)){
+            int n;
+            if(parse_uint(tok.data()+key.size()+1, tok.data()+tok.size(), n)) v = n;
+        }
+    });
+    return v;
+}
+
+static std::string bank_field(int bank){
+    return bank ? "\"bank\":" + std::to_string(bank) + "," : std::string{};
+}
+
+// batch set 프레임. 채널 목록/범위 목록/256비트 마스크 중 가장 짧은 표현을 고른다.
+//   {"cmd":"set","chs":[1,2,3],"val":true}
+//   {"cmd":"set","ranges":[[100,231]],"val":true}
+//   {"cmd":"set","mask":"<64 hex>","val":true}   (바이트 i = 채널 8i..8i+7, LSB 먼저)
+// bank 가 0 이 아니면 "bank":B 를 붙이고 채널 번호는 bank 안 번호.
+static std::string batch_set_payload(const ChannelSet& chs, bool val, const char*& kind, int bank = 0){
+    std::string list, ranges;
+    chs.for_each_range([&](int a, int b){
+        if(!ranges.empty()) ranges += ',';
+        ranges += '[' + std::to_string(a) + ',' + std::to_string(b) + ']';
+    });
+    chs.for_each([&](int ch){
+        if(!list.empty()) list += ',';
+        list += std::to_string(ch);
+    });
+    static const char hex[] = "0123456789abcdef";
+    std::string mask;
+    for(int i=0;i<ChannelSet::kChannels/8;++i){
+        unsigned b = static_cast<unsigned>(chs.w[i>>3] >> ((i&7)*8)) & 0xff;
+        mask += hex[b>>4];
+        mask += hex[b&15];
+    }
+
+    std::string body = "\"chs\":["+list+"]";
+    kind = "list";
+    std::string alt = "\"ranges\":["+ranges+"]";
+    if(alt.size()<body.size()){ body.swap(alt); kind = "ranges"; }
+    alt = "\"mask\":\""+mask+"\"";
+    if(alt.size()<body.size()){ body.swap(alt); kind = "mask"; }
+    return "{\"cmd\":\"set\"," + bank_field(bank) + body + ",\"val\":" + (val?"true":"false") + "}";
+}
+
+// ── 바이너리 프로토콜 ───────────────────────────────────────────────────────────
+// 핸드셰이크에서 Sec-WebSocket-Protocol: kulgad.bin.v1 을 제안하고 서버가 같은 값을 돌려주면
+// 모든 프레임을 binary 로 주고받는다. 돌려주지 않으면 JSON 그대로.
+//   get    : [0x01][bank u16 LE (bank>0 일 때)]
+//   set    : [0x02][flags: bit0=val, bit1=id 있음, bit2=bank 있음][id u32 LE (bit1)][bank u16 LE (bit2)][mask 32B]
+//   status : [0x81][size u16 LE][bitmap 32B][bank u16 LE (bank>0 일 때)]
+//   ack    : [0x82][ok 0|1][id u32 LE]
+// mask/bitmap 은 JSON "mask" 와 같은 순서 (바이트 i 의 비트 j = 채널 8i+j)
+static constexpr const char* kBinaryProtocol = "kulgad.bin.v1";
+enum : unsigned char { kBinGet=0x01, kBinSet=0x02, kBinStatus=0x81, kBinAck=0x82 };
+enum : unsigned char { kBinFlagVal=1, kBinFlagId=2, kBinFlagBank=4 };
+
+static void put_bitmap(std::string& out, const ChannelSet& chs){
+    for(int i=0;i<ChannelSet::kChannels/8;++i) out += static_cast<char>(chs.w[i>>3] >> ((i&7)*8));
+}
+static void put_u16(std::string& out, int v){
+    out += static_cast<char>(v);
+    out += static_cast<char>(v>>8);
+}
+
+static std::string binary_set_payload(const ChannelSet& chs, bool val, int bank = 0){
+    std::string f{static_cast<char>(kBinSet), static_cast<char>((val ? kBinFlagVal : 0) | (bank ? kBinFlagBank : 0))};
+    if(bank) put_u16(f, bank);
+    put_bitmap(f, chs);
+    return f;
+}
+
+// ack 모드: flags 에 id 비트를 켜고 flags 뒤에 id 를 끼운다
+static void binary_set_id(std::string& frame, std::uint32_t id){
+    frame[1] = static_cast<char>(frame[1] | kBinFlagId);
+    char le[4] = {char(id), char(id>>8), char(id>>16), char(id>>24)};
+    frame.insert(2, le, 4);
+}
+
+static std::string get_payload(bool binary, int bank = 0){
+    if(!binary) return bank ? "{\"cmd\":\"get\",\"bank\":" + std::to_string(bank) + "}" : R"({"cmd":"get"})";
+    std::string f(1, static_cast<char>(kBinGet));
+    if(bank) put_u16(f, bank);
+    return f;
+}
+
+static bool decode_pins_binary(const char* p, size_t len, Pins& pins){
+    constexpr size_t kLen = 3+ChannelSet::kChannels/8;
+    if((len!=kLen && len!=kLen+2) || static_cast<unsigned char>(p[0])!=kBinStatus) return false;
+    int size = static_cast<unsigned char>(p[1]) | static_cast<unsigned char>(p[2])<<8;
+    if(size>ChannelSet::kChannels) return false;
+    pins = Pins{};
+    pins.size = size;
+    for(int i=0;i<ChannelSet::kChannels/8;++i)
+        pins.on.w[i>>3] |= std::uint64_t(static_cast<unsigned char>(p[3+i])) << ((i&7)*8);
+    pins.on &= ChannelSet::first_n(size);
+    if(len==kLen+2) pins.bank = static_cast<unsigned char>(p[kLen]) | static_cast<unsigned char>(p[kLen+1])<<8;
+    return true;
+}
+
+// ── pins 디코더 ─────────────────────────────────────────────────────────────
+// 수신 프레임(flat_buffer)을 복사하지 않고 그대로 읽는다. 최상위 객체 구조를 검증하면서
+// 다른 키의 값(중첩 배열/문자열 포함)은 건너뛰고, "pins" 배열은 32바이트 단위로
+// 't' / 'f' / ']' 위치를 SIMD 비교로 찾아 비트마스크로 분류한다.
+// 't','f' 는 각각 true/false 리터럴의 첫 글자에만 나오므로 시작 위치가 곧 원소 값이고,
+// 리터럴 본문과 사이의 구분자(공백, 쉼표 하나)는 스칼라로 검증한다.
+
+static constexpr int kJsonMaxDepth = 64;
+
+static inline bool json_ws(char c){ return c==' ' || c=='\t' || c=='\n' || c=='\r'; }
+
+static const char* json_skip_ws(const char* p, const char* end){
+    while(p<end && json_ws(*p)) ++p;
+    return p;
+}
+
+// p 는 여는 '"'. 닫는 '"' 다음 위치, 잘못되면 nullptr.
+static const char* json_skip_string(const char* p, const char* end){
+    for(++p; p<end; ++p){
+        if(*p=='\\'){ if(++p==end) return nullptr; }
+        else if(*p=='"') return p+1;
+    }
+    return nullptr;
+}
+
+static const char* json_skip_value(const char* p, const char* end, int depth){
+    if(p==end || depth>kJsonMaxDepth) return nullptr;
+    if(*p=='"') return json_skip_string(p, end);
+    if(*p=='{' || *p=='['){
+        const bool obj = (*p=='{');
+        const char close = obj ? '}' : ']';
+        p = json_skip_ws(p+1, end);
+        if(p<end && *p==close) return p+1;
+        for(;;){
+            if(obj){
+                if(p==end || *p!='"') return nullptr;
+                if(!(p = json_skip_string(p, end))) return nullptr;
+                p = json_skip_ws(p, end);
+                if(p==end || *p!=':') return nullptr;
+                p = json_skip_ws(p+1, end);
+            }
+            if(!(p = json_skip_value(p, end, depth+1))) return nullptr;
+            p = json_skip_ws(p, end);
+            if(p==end) return nullptr;
+            if(*p==close) return p+1;
+            if(*p!=',') return nullptr;
+            p = json_skip_ws(p+1, end);
+        }
+    }
+    // 숫자 / true / false / null
+    const char* s = p;
+    while(p<end && (std::isalnum(static_cast<unsigned char>(*p)) || *p=='-' || *p=='+' || *p=='.')) ++p;
+    return p==s ? nullptr : p;
+}
+
+struct ChunkMasks{ std::uint32_t t, f, close; };
+
+static inline ChunkMasks classify_tail(const char* p, size_t n){
+    ChunkMasks m{0, 0, 0};
+    for(size_t i=0;i<n;++i){
+        m.t     |= std::uint32_t(p[i]=='t') << i;
+        m.f     |= std::uint32_t(p[i]=='f') << i;
+        m.close |= std::uint32_t(p[i]==']') << i;
+    }
+    return m;
+}
+
+// 32바이트 분류. 경로마다 이름을 따로 두어 kulgad_fuzz 가 모두 같은 결과인지 비교한다.
+static inline ChunkMasks classify32_scalar(const char* p){ return classify_tail(p, 32); }
+
+#if defined(__SSE2__)
+static inline ChunkMasks classify32_sse2(const char* p){
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p+16));
+    auto eq = [&](char c){
+        __m128i k = _mm_set1_epi8(c);
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(lo, k)))
+             | static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(hi, k))) << 16;
+    };
+    return {eq('t'), eq('f'), eq(']')};
+}
+#endif
+
+#if defined(__AVX2__)
+static inline ChunkMasks classify32_avx2(const char* p){
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    auto eq = [&](char c){
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))));
+    };
+    return {eq('t'), eq('f'), eq(']')};
+}
+#endif
+
+// 빌드 옵션으로 고른 기본 경로
+static inline ChunkMasks classify32(const char* p){
+#if defined(__AVX2__)
+    return classify32_avx2(p);
+#elif defined(__SSE2__)
+    return classify32_sse2(p);
+#else
+    return classify32_scalar(p);
+#endif
+}
+
+// 직전 원소 뒤 [p, e) 가 공백만(comma=false) 또는 공백*,공백*(comma=true) 인지
+static bool json_separator_ok(const char* p, const char* e, bool comma){
+    p = json_skip_ws(p, e);
+    if(comma){
+        if(p==e || *p!=',') return false;
+        p = json_skip_ws(p+1, e);
+    }
+    return p==e;
+}
+
+// p 는 '[' 다음. 성공 시 ']' 다음 위치.
+using Classify32 = ChunkMasks (*)(const char*);
+
+template<Classify32 Classify>
+static const char* decode_bool_array(const char* p, const char* end, Pins& pins){
+    const char* cursor = p;
+    int n = 0;
+    for(const char* base=p; base<end; base+=32){
+        ChunkMasks m = (end-base>=32) ? Classify(base) : classify_tail(base, end-base);
+        for(std::uint32_t any = m.t|m.f|m.close; any; any &= any-1){
+            int bit = __builtin_ctz(any);
+            const char* s = base + bit;
+            if(s<cursor) continue;
+            if((m.close>>bit) & 1){
+                if(!json_separator_ok(cursor, s, false)) return nullptr;
+                pins.size = std::min(n, ChannelSet::kChannels);
+                return s+1;
+            }
+            if(!json_separator_ok(cursor, s, n>0)) return nullptr;
+            if((m.t>>bit) & 1){
+                if(end-s<4 || std::memcmp(s, "true", 4)!=0) return nullptr;
+                if(n<ChannelSet::kChannels) pins.on.set(n);
+                cursor = s+4;
+            }else{
+                if(end-s<5 || std::memcmp(s, "false", 5)!=0) return nullptr;
+                cursor = s+5;
+            }
+            ++n;
+        }
+    }
+    return nullptr;
+}
+
+// {"pins":[true,false,...], "bank":B, ...} 에서 pins 배열(과 bank)을 읽는다. 구조가 잘못됐거나 pins 가 없으면 false.
+// 빈 배열 "pins":[] 도 이전 파서(parse_pins_from_json)와 같이 pins 없음으로 본다.
+template<Classify32 Classify = classify32>
+static bool decode_pins(const char* p, size_t len, Pins& pins){
+    pins = Pins{};
+    const char* end = p + len;
+    bool found = false;
+    p = json_skip_ws(p, end);
+    if(p==end || *p!='{') return false;
+    p = json_skip_ws(p+1, end);
+    if(p<end && *p=='}') return false;
+    for(;;){
+        if(p==end || *p!='"') return false;
+        const char* key = p+1;
+        if(!(p = json_skip_string(p, end))) return false;
+        const bool is_pins = (p-key-1==4 && std::memcmp(key, "pins", 4)==0);
+        const bool is_bank = (p-key-1==4 && std::memcmp(key, "bank", 4)==0);
+        p = json_skip_ws(p, end);
+        if(p==end || *p!=':') return false;
+        p = json_skip_ws(p+1, end);
+        if(is_pins && !found){
+            if(p==end || *p!='[') return false;
+            p = decode_bool_array<Classify>(p+1, end, pins);
+            found = true;
+        }else if(is_bank){
+            const char* s = p;
+            while(p<end && *p>='0' && *p<='9') ++p;
+            if(!parse_uint(s, p, pins.bank) || pins.bank>=kMaxChannels/kBankChannels) return false;
+        }else{
+            p = json_skip_value(p, end, 1);
+        }
+        if(!p) return false;
+        p = json_skip_ws(p, end);
+        if(p==end) return false;
+        if(*p=='}') break;
+        if(*p!=',') return false;
+        p = json_skip_ws(p+1, end);
+    }
+    return found && pins.size>0 && json_skip_ws(p+1, end)==end;
+}
+
+static bool decode_pins(const beast::flat_buffer& buf, Pins& pins){
+    auto d = buf.data();
+    auto p = static_cast<const char*>(d.data());
+    if(d.size() && static_cast<unsigned char>(p[0])==kBinStatus) return decode_pins_binary(p, d.size(), pins);
+    return decode_pins(p, d.size(), pins);
+}
+
+// 이전 파서 (부분 문자열 검색). 구조 검증 없이 관대하게 읽으므로 decode_pins 가 받아들인 프레임은
+// 여기서도 같은 결과여야 한다. kulgad_fuzz 가 이 관계를 확인하는 기준 구현으로 쓴다.
+[[maybe_unused]] static bool parse_pins_from_json(const std::string& js, Pins& pins){
+    pins = Pins{};
+    auto p = js.find("\"pins\""); if(p==std::string::npos) return false;
+    auto lb=js.find('[',p); if(lb==std::string::npos) return false;
+    auto rb=js.find(']',lb); if(rb==std::string::npos) return false;
+    int n=0;
+    for(size_t i=lb+1;i<rb;++i){
+        if(i+4<=rb && js.compare(i,4,"true")==0){ if(n<ChannelSet::kChannels) pins.on.set(n); ++n; i+=3; }
+        else if(i+5<=rb && js.compare(i,5,"false")==0){ ++n; i+=4; }
+    }
+    pins.size = std::min(n, ChannelSet::kChannels);
+    return n>0;
+}
+
+// ack 프레임이면 true. ok 에 결과, id 에 프레임 id (없으면 0).
+// binary: [0x82][ok][id u32 LE]. JSON: 최상위 객체의 "ok"(true/false)와 "id"(10진 정수)를
+// pins 디코더와 같은 방식으로 구조를 검증하며 읽는다. 구조가 잘못됐거나 "ok" 가 없으면 ack 가 아니다.
+static bool decode_ack(const std::string& body, bool& ok, std::uint32_t& id){
+    id = 0;
+    if(!body.empty() && static_cast<unsigned char>(body[0])==kBinAck){
+        if(body.size()<2) return false;
+        ok = body[1]!=0;
+        if(body.size()>=6) for(int k=3;k>=0;--k) id = id<<8 | static_cast<unsigned char>(body[2+k]);
+        return true;
+    }
+    const char* p = body.data();
+    const char* end = p + body.size();
+    bool have_ok = false;
+    p = json_skip_ws(p, end);
+    if(p==end || *p!='{') return false;
+    p = json_skip_ws(p+1, end);
+    if(p<end && *p=='}') return false;
+    for(;;){
+        if(p==end || *p!='"') return false;
+        const char* key = p+1;
+        if(!(p = json_skip_string(p, end))) return false;
+        const bool is_ok = (p-key-1==2 && std::memcmp(key, "ok", 2)==0);
+        const bool is_id = (p-key-1==2 && std::memcmp(key, "id", 2)==0);
+        p = json_skip_ws(p, end);
+        if(p==end || *p!=':') return false;
+        p = json_skip_ws(p+1, end);
+        const char* v = p;
+        if(!(p = json_skip_value(p, end, 1))) return false;
+        if(is_ok){
+            if(p-v==4 && std::memcmp(v, "true", 4)==0) ok = true;
+            else if(p-v==5 && std::memcmp(v, "false", 5)==0) ok = false;
+            else return false;
+            have_ok = true;
+        }else if(is_id){
+            id = 0;
+            for(const char* q=v; q<p; ++q){
+                if(*q<'0' || *q>'9' || id>(UINT32_MAX-9)/10) return false;
+                id = id*10 + static_cast<std::uint32_t>(*q-'0');
+            }
+        }
+        p = json_skip_ws(p, end);
+        if(p==end) return false;
+        if(*p=='}') break;
+        if(*p!=',') return false;
+        p = json_skip_ws(p+1, end);
+    }
+    return have_ok && json_skip_ws(p+1, end)==end;
+}
+
+// 토큰 버킷: 초당 rate개씩 채워지고 최대 burst개까지 쌓인다. rate<=0 이면 무제한.
+// take()는 토큰 1개를 예약하고 전송 가능 시각을 돌려준다(잔량이 음수면 그만큼 미래).
+struct TokenBucket{
+    using clock = std::chrono::steady_clock;
+    double rate, burst, tokens;
+    clock::time_point last;
+
+    TokenBucket(double r, double b): rate(r), burst(b<1 ? 1 : b), tokens(burst), last(clock::now()){}
+
+    clock::time_point take(){
+        auto now = clock::now();
+        if(rate<=0) return now;
+        tokens = std::min(burst, tokens + rate*std::chrono::duration<double>(now-last).count());
+        last = now;
+        tokens -= 1;
+        if(tokens>=0) return now;
+        return now + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(-tokens/rate));
+    }
+};
+
+// ── 계측 (--stats) ───────────────────────────────────────────────────────────
+// HDR 스타일 히스토그램 (ns 단위). 0..31 은 정확히, 그 위로는 2의 거듭제곱 구간마다
+// 16개 하위 버킷을 두어 상대 오차 1/16 이내로 기록한다. 기록은 O(1), 할당 없음.
+class LatencyHistogram{
+public:
+    static constexpr int kSub = 16;
+    static constexpr int kBuckets = 61*kSub;
+
+    void record(std::chrono::steady_clock::duration d){
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        std::uint64_t v = ns>0 ? static_cast<std::uint64_t>(ns) : 0;
+        ++counts_[index(v)];
+        ++total_;
+        sum_ += v;
+        min_ = std::min(min_, v);
+        max_ = std::max(max_, v);
+    }
+
+    std::uint64_t count() const { return total_; }
+    double sum_ms() const { return sum_/1e6; }
+    double min_ms() const { return total_ ? min_/1e6 : 0; }
+    double max_ms() const { return max_/1e6; }
+
+    double percentile_ms(double p) const {
+        if(!total_) return 0;
+        auto rank = static_cast<std::uint64_t>(std::ceil(p*total_));
+        if(rank<1) rank = 1;
+        std::uint64_t seen = 0;
+        for(int i=0;i<kBuckets;++i){
+            seen += counts_[i];
+            if(seen>=rank){
+                std::uint64_t mid = lower(i) + (upper(i)-lower(i))/2;
+                return std::min(std::max(mid, min_), max_)/1e6;
+            }
+        }
+        return max_/1e6;
+    }
+
+    // 값이 le_ns 이하인 기록 수 (버킷 상한 기준 근사)
+    std::uint64_t count_le(std::uint64_t le_ns) const {
+        std::uint64_t n = 0;
+        for(int i=0;i<kBuckets && upper(i)<=le_ns;++i) n += counts_[i];
+        return n;
+    }
+
+private:
+    static int index(std::uint64_t v){
+        if(v<2*kSub) return static_cast<int>(v);
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - 4;
+        return (shift+1)*kSub + static_cast<int>((v>>shift) - kSub);
+    }
+    static std::uint64_t lower(int i){
+        if(i<2*kSub) return static_cast<std::uint64_t>(i);
+        int shift = i/kSub - 1;
+        return static_cast<std::uint64_t>(kSub + i%kSub) << shift;
+    }
+    static std::uint64_t upper(int i){
+        if(i<2*kSub) return static_cast<std::uint64_t>(i);
+        int shift = i/kSub - 1;
+        return (static_cast<std::uint64_t>(kSub + i%kSub + 1) << shift) - 1;
+    }
+
+    std::array<std::uint64_t, kBuckets> counts_{};
+    std::uint64_t total_=0, sum_=0, min_=~std::uint64_t(0), max_=0;
+};
+
+enum class Phase{ resolve, connect, handshake, write, read, close, rtt };
+static constexpr int kPhaseCount = 7;
+static const char* const kPhaseNames[kPhaseCount] = {"resolve", "connect", "handshake", "write", "read", "close", "rtt"};
+
+// 대상 하나의 단계별 히스토그램. 한 대상은 한 strand/스레드에서만 기록하므로 잠금이 없다.
+struct PhaseStats{
+    std::array<LatencyHistogram, kPhaseCount> h;
+    bool attempted = false;     // 연결을 시도했는지 (Connector::start)
+
+    void record(Phase p, std::chrono::steady_clock::duration d){ h[static_cast<int>(p)].record(d); }
+
+    // t0 부터 지금까지를 기록하고 t0 를 지금으로 옮긴다
+    void lap(Phase p, std::chrono::steady_clock::time_point& t0){
+        auto now = std::chrono::steady_clock::now();
+        record(p, now-t0);
+        t0 = now;
+    }
+};
+
+// 대상("host:port")별 통계. 대상 추가는 I/O 시작 전 main 스레드에서만 한다.
+class Stats{
+public:
+    PhaseStats& target(const std::string& name){ return targets_[name]; }
+
+    // 어느 대상이든 연결을 시도했으면 true. 인자 오류 등으로 연결 전에 끝나면 내보낼 것이 없다.
+    bool attempted() const {
+        for(const auto& [name, ps]: targets_) if(ps.attempted) return true;
+        return false;
+    }
+
+    void print(std::ostream& os) const {
+        char line[160];
+        for(const auto& [name, ps]: targets_){
+            os << "Stats for " << name << " (ms):\n";
+            std::snprintf(line, sizeof line, "  %-10s %7s %9s %9s %9s %9s %9s\n", "phase", "n", "min", "p50", "p90", "p99", "max");
+            os << line;
+            for(int i=0;i<kPhaseCount;++i){
+                const auto& h = ps.h[i];
+                if(!h.count()) continue;
+                std::snprintf(line, sizeof line, "  %-10s %7llu %9.3f %9.3f %9.3f %9.3f %9.3f\n", kPhaseNames[i],
+                              static_cast<unsigned long long>(h.count()), h.min_ms(), h.percentile_ms(0.5),
+                              h.percentile_ms(0.9), h.percentile_ms(0.99), h.max_ms());
+                os << line;
+            }
+        }
+    }
+
+    void write_json(std::ostream& os) const {
+        os << "{\"targets\":{";
+        bool first_t = true;
+        for(const auto& [name, ps]: targets_){
+            os << (first_t ? "" : ",") << "\"" << escape(name, false) << "\":{";
+            first_t = false;
+            bool first_p = true;
+            for(int i=0;i<kPhaseCount;++i){
+                const auto& h = ps.h[i];
+                if(!h.count()) continue;
+                os << (first_p ? "" : ",") << "\"" << kPhaseNames[i] << "\":{"
+                   << "\"count\":" << h.count() << ",\"sum_ms\":" << h.sum_ms()
+                   << ",\"min_ms\":" << h.min_ms() << ",\"p50_ms\":" << h.percentile_ms(0.5)
+                   << ",\"p90_ms\":" << h.percentile_ms(0.9) << ",\"p99_ms\":" << h.percentile_ms(0.99)
+                   << ",\"max_ms\":" << h.max_ms() << "}";
+                first_p = false;
+            }
+            os << "}";
+        }
+        os << "}}\n";
+    }
+
+    // node_exporter textfile collector 형식의 히스토그램
+    void write_prometheus(std::ostream& os) const {
+        static const double kLe[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                                     0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+        os << "# HELP kulgad_phase_seconds Time spent in each kulgad-cli I/O phase.\n"
+           << "# TYPE kulgad_phase_seconds histogram\n";
+        for(const auto& [name, ps]: targets_){
+            for(int i=0;i<kPhaseCount;++i){
+                const auto& h = ps.h[i];
+                if(!h.count()) continue;
+                std::string labels = "target=\"" + escape(name, true) + "\",phase=\"" + kPhaseNames[i] + "\"";
+                for(double le: kLe){
+                    os << "kulgad_phase_seconds_bucket{" << labels << ",le=\"" << le << "\"} "
+                       << h.count_le(static_cast<std::uint64_t>(le*1e9)) << "\n";
+                }
+                os << "kulgad_phase_seconds_bucket{" << labels << ",le=\"+Inf\"} " << h.count() << "\n"
+                   << "kulgad_phase_seconds_sum{" << labels << "} " << h.sum_ms()/1000 << "\n"
+                   << "kulgad_phase_seconds_count{" << labels << "} " << h.count() << "\n";
+            }
+        }
+    }
+
+private:
+    // 대상 이름은 사용자 입력이므로 JSON 문자열 / Prometheus 레이블 값으로 이스케이프한다
+    // (둘 다 \\, \", \n. JSON 은 나머지 제어 문자도 \u00XX)
+    static std::string escape(const std::string& s, bool prom){
+        std::string out;
+        for(char c: s){
+            if(c=='\\' || c=='"') out += {'\\', c};
+            else if(c=='\n') out += "\\n";
+            else if(!prom && static_cast<unsigned char>(c)<0x20){
+                char hex[8];
+                std::snprintf(hex, sizeof hex, "\\u%04x", static_cast<unsigned char>(c));
+                out += hex;
+            }else out += c;
+        }
+        return out;
+    }
+
+    std::map<std::string, PhaseStats> targets_;
+};
+
+// set 프레임 송신 파이프라인.
+//  • 각 프레임은 토큰 버킷이 정한 시각에 async_write 로 나간다. 직렬화/전송 시간은 다음
+//    프레임의 대기 시간과 겹치므로 간격에 더해지지 않는다.
+//  • ack 모드: 프레임마다 "id"를 붙이고 {"ok":true,"id":N} 응답의 id 로 해당 프레임을 확인하며,
+//    응답 대기 중인 프레임이 window개를 넘지 않도록 송신을 멈춘다. {"ok":false,...}는 거부로 집계.
+//    id 가 없는 응답은 가장 오래된 대기 프레임의 것으로 보고, 모르는 id 나 중복 응답은 무시한다.
+class SetPipeline{
+public:
+    struct Frame{ std::string payload, label; };
+
+    // io_timeout: 프레임 전송과 (ack 모드) 응답 대기 각각의 제한 시간. 토큰 대기 시간은 포함하지 않는다.
+    SetPipeline(ws_stream& ws, std::vector<Frame> frames,
+                double rate, double burst, bool ack, size_t window,
+                std::ostream& out, std::ostream& err, PhaseStats* stats = nullptr,
+                std::chrono::steady_clock::duration io_timeout = {})
+      : ws_(ws), out_(out), err_(err), stats_(stats), timer_(ws.get_executor()), ack_timer_(ws.get_executor()),
+        bucket_(rate, burst),
+        frames_(std::move(frames)), ack_(ack), window_(window<1 ? 1 : window), io_timeout_(io_timeout),
+        sent_at_(frames_.size()), retired_(frames_.size())
+    {
+        if(ack_){
+            for(size_t i=0;i<frames_.size();++i){
+                auto& p = frames_[i].payload;
+                if(static_cast<unsigned char>(p[0])==kBinSet) binary_set_id(p, static_cast<std::uint32_t>(i+1));
+                else p.insert(p.size()-1, ",\"id\":" + std::to_string(i+1));
+            }
+        }
+    }
+
+    // 모든 프레임이 나가고(ack 모드면 응답까지 받고) 나거나 오류가 나면 done 을 한 번 호출
+    void start(std::function<void()> done = {}){
+        on_done_ = std::move(done);
+        if(ack_ && !frames_.empty()) read_ack();
+        schedule();
+        check_done();
+    }
+
+    beast::error_code error() const { return ec_; }
+    size_t rejected() const { return rejected_; }
+
+private:
+    void schedule(){
+        if(ec_ || next_==frames_.size()) return;
+        if(ack_ && next_-acked_>=window_){ window_full_=true; return; }
+        timer_.expires_at(bucket_.take());
+        timer_.async_wait([this](beast::error_code ec){
+            if(ec) return fail(ec);
+            write();
+        });
+    }
+
+    void write(){
+        sent_at_[next_] = std::chrono::steady_clock::now();
+        arm_timeout(ws_, io_timeout_);
+        ws_.async_write(net::buffer(frames_[next_].payload), [this](beast::error_code ec, std::size_t){
+            if(ec) return fail(ec);
+            if(stats_) stats_->record(Phase::write, std::chrono::steady_clock::now()-sent_at_[next_]);
+            if(!frames_[next_].label.empty()) out_ << "Sent: " << frames_[next_].label << "\n";
+            ++next_;
+            beast::get_lowest_layer(ws_).expires_never();
+            if(ack_ && !ack_timer_armed_) watch_acks();
+            schedule();
+            check_done();
+        });
+    }
+
+    void read_ack(){
+        buf_.consume(buf_.size());
+        ws_.async_read(buf_, [this](beast::error_code ec, std::size_t){
+            if(ec) return fail(ec);
+            std::string body = beast::buffers_to_string(buf_.data());
+            bool ok = true;
+            std::uint32_t id = 0;
+            if(decode_ack(body, ok, id)){
+                const size_t i = id ? size_t(id)-1 : oldest_;
+                if(i<next_ && !retired_[i]){
+                    retired_[i] = true;
+                    ++acked_;
+                    while(oldest_<next_ && retired_[oldest_]) ++oldest_;
+                    if(stats_) stats_->record(Phase::rtt, std::chrono::steady_clock::now()-sent_at_[i]);
+                    if(!ok){
+                        ++rejected_;
+                        err_ << "Rejected: " << (ws_.got_binary() ? "set frame " + std::to_string(i+1) : body) << "\n";
+                    }
+                    if(window_full_){ window_full_=false; schedule(); }
+                    watch_acks();
+                }
+            }
+            if(acked_<frames_.size()) read_ack();
+            check_done();
+        });
+    }
+
+    // 이미 시작된 ack read 에는 스트림 제한 시간이 걸리지 않으므로 별도 타이머로 감시:
+    // 응답 대기 중인 프레임이 있으면 io_timeout 안에 다음 ack 가 와야 한다.
+    void watch_acks(){
+        if(io_timeout_.count()<=0) return;
+        ack_timer_armed_ = acked_<next_;
+        if(!ack_timer_armed_){ ack_timer_.cancel(); return; }
+        ack_timer_.expires_after(io_timeout_);
+        ack_timer_.async_wait([this](beast::error_code ec){
+            if(!ec) fail(beast::error::timeout);
+        });
+    }
+
+    void fail(beast::error_code ec){
+        if(ec_) return;
+        ec_ = ec;
+        timer_.cancel();
+        ack_timer_.cancel();
+        beast::get_lowest_layer(ws_).cancel();
+        check_done();
+    }
+
+    void check_done(){
+        if(done_) return;
+        if(!ec_ && (next_<frames_.size() || (ack_ && acked_<frames_.size()))) return;
+        done_ = true;
+        ack_timer_.cancel();
+        if(on_done_) on_done_();
+    }
+
+    ws_stream& ws_;
+    std::ostream& out_;
+    std::ostream& err_;
+    PhaseStats* stats_;
+    net::steady_timer timer_, ack_timer_;
+    TokenBucket bucket_;
+    std::vector<Frame> frames_;
+    bool ack_;
+    size_t window_;
+    std::chrono::steady_clock::duration io_timeout_;
+    std::vector<std::chrono::steady_clock::time_point> sent_at_;
+    std::vector<bool> retired_;         // ack 를 받은 프레임
+    size_t next_=0, acked_=0, oldest_=0, rejected_=0;
+    bool window_full_=false, done_=false, ack_timer_armed_=false;
+    std::function<void()> on_done_;
+    beast::flat_buffer buf_;
+    beast::error_code ec_;
+};
+
+
+// 로컬 시각 "YYYY-MM-DD HH:MM:SS.mmm"
+static std::string timestamp_now(){
+    auto now = std::chrono::system_clock::now();
+    std::time_t t = std::chrono::system_clock::to_time_t(now);
+    int ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count()%1000);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof buf, "%Y-%m-%d %H:%M:%S", &tm);
+    char out[40];
+    std::snprintf(out, sizeof out, "%s.%03d", buf, ms);
+    return out;
+}
+
+// --watch: 연결을 유지하며 pins 갱신(서버 push 또는 interval 주기의 get 응답)을 비동기로 읽고,
+// 직전 상태와 달라진 채널만 타임스탬프와 함께 출력한다. SIGINT/SIGTERM 으로 정상 종료.
+// 여러 bank 에 걸치면 주기마다 bank 별 get 을 연달아 보내고 응답은 bank 로 구분한다.
+class PinWatcher{
+public:
+    // channels 는 clamp() 된 선택. io_timeout: 폴링 get 에 대한 응답 제한 시간 (push 만 받는 interval 0 에서는 쓰지 않음)
+    PinWatcher(ws_stream& ws, const ChannelRanges& channels,
+               std::chrono::steady_clock::duration interval, std::ostream& out, bool binary = false,
+               std::chrono::steady_clock::duration io_timeout = {})
+      : ws_(ws), out_(out), timer_(ws.get_executor()), reply_timer_(ws.get_executor()),
+        signals_(ws.get_executor(), SIGINT, SIGTERM),
+        channels_(channels), interval_(interval), io_timeout_(io_timeout)
+    {
+        channels_.for_each_bank([&](int b, const ChannelSet& chs){
+            banks_[b] = chs;
+            gets_.push_back(get_payload(binary, b));
+        });
+    }
+
+    void start(){
+        // get 을 쓰는 중에 close 프레임을 같이 쓰면 안 되므로, 쓰는 중이면 write_get 완료 후에 닫는다
+        signals_.async_wait([this](beast::error_code ec, int){
+            if(ec) return;
+            stopping_ = true;
+            timer_.cancel();
+            reply_timer_.cancel();
+            if(!writing_) close();
+        });
+        read();
+        poll();
+    }
+
+    beast::error_code error() const { return ec_; }
+
+private:
+    void poll(){
+        // read 는 항상 걸려 있으므로 스트림 제한 시간 대신 응답 타이머로 감시
+        if(awaiting_==0 && interval_.count()>0 && io_timeout_.count()>0){
+            awaiting_ = gets_.size();
+            reply_timer_.expires_after(io_timeout_);
+            reply_timer_.async_wait([this](beast::error_code ec){
+                if(!ec && awaiting_) fail(beast::error::timeout);
+            });
+        }
+        if(!writing_) write_get(0);
+        if(interval_.count()>0){
+            timer_.expires_after(interval_);
+            timer_.async_wait([this](beast::error_code ec){
+                if(!ec && !stopping_) poll();
+            });
+        }
+    }
+
+    void write_get(size_t i){
+        writing_ = i<gets_.size();
+        if(!writing_) return;
+        ws_.async_write(net::buffer(gets_[i]), [this, i](beast::error_code ec, std::size_t){
+            if(ec){ writing_ = false; return fail(ec); }
+            if(!stopping_) return write_get(i+1);
+            writing_ = false;
+            close();
+        });
+    }
+
+    void close(){
+        if(closing_) return;
+        closing_ = true;
+        ws_.async_close(websocket::close_code::normal, [](beast::error_code){});
+    }
+
+    void read(){
+        buf_.consume(buf_.size());
+        ws_.async_read(buf_, [this](beast::error_code ec, std::size_t){
+            if(ec) return fail(ec);
+            Pins pins;
+            if(decode_pins(buf_, pins) && banks_.count(pins.bank)){
+                if(awaiting_ && --awaiting_==0) reply_timer_.cancel();
+                update(pins);
+            }
+            read();
+        });
+    }
+
+    // 채널 상태: 1=on, 0=off, -1=n/a
+    static int state(const Pins& pins, int ch){
+        return ch<pins.size ? (pins.on.test(ch) ? 1 : 0) : -1;
+    }
+
+    // 바뀐 채널 = (on 차이 | 유효 범위 차이) & 감시 채널. 모든 bank 를 한 번씩 받은 뒤 첫 줄을 출력.
+    void update(const Pins& pins){
+        static const char* names[] = {"n/a", "off", "on"};
+        const ChannelSet& watched = banks_[pins.bank];
+        auto it = prev_.find(pins.bank);
+        if(it==prev_.end()){
+            prev_[pins.bank] = pins;
+            if(prev_.size()<banks_.size()) return;
+            long long on = 0;
+            for(auto& [b, p]: prev_) on += (p.on & ChannelSet::first_n(p.size) & banks_[b]).count();
+            out_ << timestamp_now() << " watching " << channels_.count() << " channels, " << on << " on\n" << std::flush;
+            return;
+        }
+        const Pins& prev = it->second;
+        ChannelSet changed = ((prev.on ^ pins.on) | (ChannelSet::first_n(prev.size) ^ ChannelSet::first_n(pins.size)))
+                           & watched;
+        if(prev_.size()==banks_.size()){
+            changed.for_each([&](int ch){
+                out_ << timestamp_now() << " ch=" << pins.bank*kBankChannels + ch << " " << names[state(prev, ch)+1]
+                     << "->" << names[state(pins, ch)+1] << "\n";
+            });
+            if(!changed.empty()) out_ << std::flush;
+        }
+        it->second = pins;
+    }
+
+    void fail(beast::error_code ec){
+        if(ec_ || (stopping_ && ec==websocket::error::closed)) return;
+        if(stopping_ && ec==net::error::operation_aborted) return;
+        ec_ = ec;
+        timer_.cancel();
+        reply_timer_.cancel();
+        signals_.cancel();
+        beast::get_lowest_layer(ws_).cancel();
+    }
+
+    ws_stream& ws_;
+    std::ostream& out_;
+    net::steady_timer timer_, reply_timer_;
+    net::signal_set signals_;
+    ChannelRanges channels_;
+    std::map<int, ChannelSet> banks_;   // bank → 감시 채널
+    std::vector<std::string> gets_;     // bank 별 get 프레임 (write 중에도 살아 있어야 함)
+    std::chrono::steady_clock::duration interval_, io_timeout_;
+    std::map<int, Pins> prev_;
+    size_t awaiting_=0;
+    bool writing_=false, stopping_=false, closing_=false;
+    beast::flat_buffer buf_;
+    beast::error_code ec_;
+};
+
+struct Options{
+    std::string host = "localhost";
+    std::string port = "3001";
+    bool allow_batch = true;
+    double rate = 20, burst = 1, window = 8;
+    bool ack = false;
+    bool binary = false;        // --binary: kulgad.bin.v1 subprotocol 제안 (거절되면 JSON)
+    bool one_line = false;      // 스크립트 모드: 명령당 결과 한 줄
+    Stats* stats = nullptr;     // --stats 계측 대상 (없으면 계측 안 함)
+    bool diff = false;          // --diff: 이미 목표 상태인 채널은 보내지 않음
+    std::string cache;          // --cache: 핀 스냅샷 파일 (비면 대상별 기본 경로)
+    std::chrono::steady_clock::duration cache_ttl{};
+    bool verify = false;        // --verify: set 후 get 한 번으로 확인, 다른 채널만 재전송
+    double verify_retries = 2;
+    std::chrono::steady_clock::duration verify_backoff = std::chrono::milliseconds(50);
+    std::chrono::steady_clock::duration connect_timeout = std::chrono::seconds(3);
+    std::chrono::steady_clock::duration io_timeout = std::chrono::seconds(5);
+    double connect_retries = 2;
+    std::chrono::steady_clock::duration retry_backoff = std::chrono::milliseconds(100);
+    int channels = 0;           // --channels: 컨트롤러 채널 수 (0 이면 핸드셰이크 caps, 없으면 256)
+};
+
+
+// 한 번의 set/get 요청 (채널은 정렬·중복 제거된 상태)
+struct Request{
+    bool set=false, get=false, val=false;
+    ChannelRanges channels;
+};
+
+// 데몬/스크립트가 주고받는 한 줄 명령: "set <channels> on|off", "get <channels>"
+static bool parse_request_line(const std::string& line, Request& req, std::ostream& err){
+    std::istringstream in{line};
+    std::string verb, word;
+    in >> verb;
+    verb = lower_copy(verb);
+    if(verb=="set") req.set = true;
+    else if(verb=="get") req.get = true;
+    else{ err<<"Unknown command: "<<verb<<"\n"; return false; }
+    bool have_val=false;
+    while(in >> word){
+        std::string low = lower_copy(word);
+        if(req.set && (low=="on" || low=="off")){ have_val=true; req.val=(low=="on"); continue; }
+        if(!parse_channels_token(word, req.channels, err)) return false;
+    }
+    if(req.channels.empty()){ err<<"No channels provided.\n"; return false; }
+    if(req.set && !have_val){ err<<"Missing value for set. Use on or off\n"; return false; }
+    return true;
+}
+
+static std::string request_lines(const Request& req){
+    std::string lines;
+    if(req.set) lines += "set " + format_channels(req.channels) + (req.val ? " on\n" : " off\n");
+    if(req.get) lines += "get " + format_channels(req.channels) + "\n";
+    return lines;
+}
+
+// set 요청을 프레임으로: 서버가 batch 를 지원하면 bank 당 1프레임, 아니면 채널당 1프레임
+static std::vector<SetPipeline::Frame> build_set_frames(const Request& req, bool batch, bool binary = false){
+    std::vector<SetPipeline::Frame> frames;
+    const char* onoff = req.val ? "on" : "off";
+    if(!batch) frames.reserve(static_cast<size_t>(req.channels.count()));
+    req.channels.for_each_bank([&](int bank, const ChannelSet& channels){
+        const int base = bank*kBankChannels;
+        if(binary && batch){
+            ChannelRanges global;
+            global.add_bank(bank, channels);
+            frames.push_back({binary_set_payload(channels, req.val, bank),
+                              "set ch="+format_channels(global)+" ("+std::to_string(channels.count())
+                              +" channels, binary) val="+onoff});
+        }else if(binary){
+            channels.for_each([&](int ch){
+                ChannelSet one;
+                one.set(ch);
+                frames.push_back({binary_set_payload(one, req.val, bank), "set ch="+std::to_string(base+ch)+" val="+onoff});
+            });
+        }else if(batch){
+            ChannelRanges global;
+            global.add_bank(bank, channels);
+            const char* kind = "";
+            std::string payload = batch_set_payload(channels, req.val, kind, bank);
+            frames.push_back({std::move(payload),
+                              "set ch="+format_channels(global)+" ("+std::to_string(channels.count())
+                              +" channels, "+kind+") val="+onoff});
+        }else{
+            channels.for_each([&](int ch){
+                frames.push_back({std::string("{\"cmd\":\"set\",") + bank_field(bank) + "\"ch\":" + std::to_string(ch)
+                                    + ",\"val\":" + (req.val?"true":"false") + "}",
+                                  "set ch="+std::to_string(base+ch)+" val="+onoff});
+            });
+        }
+    });
+    return frames;
+}
+
+static void print_status(std::ostream& out, const ChannelRanges& channels, const BankPins& pins, bool one_line){
+    // 채널 순서대로 돌므로 bank 가 바뀔 때만 찾는다
+    const Pins* cur = nullptr;
+    int cur_bank = -1;
+    auto state = [&](int ch){
+        if(ch/kBankChannels!=cur_bank){
+            cur_bank = ch/kBankChannels;
+            auto it = pins.find(cur_bank);
+            cur = it==pins.end() ? nullptr : &it->second;
+        }
+        int local = ch%kBankChannels;
+        return !cur || local>=cur->size ? "n/a" : cur->on.test(local) ? "on" : "off";
+    };
+    if(one_line){
+        out << "get " << format_channels(channels) << ":";
+        channels.for_each([&](int ch){ out << " " << ch << ":" << state(ch); });
+        out << "\n";
+        return;
+    }
+    out << "Status:\n";
+    int per_line=16, cnt=0;
+    channels.for_each([&](int ch){
+        out << ch << ":" << state(ch) << ((++cnt%per_line)?"  ":"\n");
+    });
+    if(cnt%per_line) out << "\n";
+}
+
+// ── --seq 시퀀스 ─────────────────────────────────────────────────────────────
+// 같은 tick 에 떨어진 이벤트는 합쳐서 on/off 각각 한 번의 set 으로 보낸다 (같은 채널은 나중 정의가 우선)
+struct SeqTick{ long long tick; ChannelRanges on, off; };
+// 파싱한 단계 하나. chs 의 "all" 은 연결 전이라 열린 구간으로 남아 있다.
+struct SeqStep{
+    using duration = std::chrono::steady_clock::duration;
+    int no = 0;
+    std::string text, verb;
+    ChannelRanges chs;
+    bool val = true;
+    duration at{}, every{}, width{}, step_len{};
+    long long times = 1;
+};
+struct Sequence{
+    std::chrono::steady_clock::duration tick = std::chrono::milliseconds(1);
+    std::vector<SeqStep> steps;     // parse_sequence 결과
+    std::vector<SeqTick> ticks;     // expand_sequence 결과, tick 순
+    size_t events = 0;
+};
+
+// 시퀀스 시작 시각 + tick 간격의 절대 deadline 마다 set 을 보낸다. 앞 tick 전송이 늦어져도
+// 다음 deadline 은 밀리지 않으므로 지연이 누적되지 않는다. deadline 대비 전송 시작 지연을 기록.
+class SequenceRunner{
+public:
+    SequenceRunner(ws_stream& ws, const Sequence& seq, const Options& opt, bool batch, bool binary,
+                   std::ostream& out, PhaseStats* stats = nullptr)
+      : ws_(ws), seq_(seq), opt_(opt), batch_(batch), binary_(binary), out_(out), stats_(stats),
+        timer_(ws.get_executor()) {}
+
+    void start(){
+        start_ = std::chrono::steady_clock::now();
+        schedule();
+    }
+
+    beast::error_code error() const { return ec_; }
+    size_t rejected() const { return rejected_; }
+
+    void report(std::ostream& out) const {
+        auto planned = seq_.ticks.empty() ? 0.0
+                     : std::chrono::duration<double, std::milli>(seq_.tick*seq_.ticks.back().tick).count();
+        char line[160];
+        std::snprintf(line, sizeof line, "Sequence: %zu event(s) in %zu tick(s), %zu frame(s), planned %.3f ms, took %.3f ms\n",
+                      seq_.events, seq_.ticks.size(), frames_, planned, std::chrono::duration<double, std::milli>(end_-start_).count());
+        out << line;
+        std::snprintf(line, sizeof line, "Jitter (ms): min %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+                      late_.min_ms(), late_.percentile_ms(0.5), late_.percentile_ms(0.9), late_.percentile_ms(0.99), late_.max_ms());
+        out << line;
+    }
+
+private:
+    void schedule(){
+        if(next_==seq_.ticks.size()){
+            end_ = std::chrono::steady_clock::now();
+            return;
+        }
+        auto deadline = start_ + seq_.tick*seq_.ticks[next_].tick;
+        timer_.expires_at(deadline);
+        timer_.async_wait([this, deadline](beast::error_code ec){
+            if(ec){ ec_ = ec; return; }
+            fire(deadline);
+        });
+    }
+
+    void fire(std::chrono::steady_clock::time_point deadline){
+        late_.record(std::chrono::steady_clock::now()-deadline);
+        const auto& t = seq_.ticks[next_];
+        std::vector<SetPipeline::Frame> frames;
+        for(bool val: {true, false}){
+            Request req;
+            req.set = true;
+            req.val = val;
+            req.channels = val ? t.on : t.off;
+            if(req.channels.empty()) continue;
+            for(auto& f: build_set_frames(req, batch_, binary_)){
+                f.label.clear();
+                frames.push_back(std::move(f));
+            }
+        }
+        frames_ += frames.size();
+        char at[32];
+        std::snprintf(at, sizeof at, "+%.3fms", std::chrono::duration<double, std::milli>(seq_.tick*t.tick).count());
+        out_ << at;
+        if(!t.on.empty())  out_ << " on "  << format_channels(t.on);
+        if(!t.off.empty()) out_ << " off " << format_channels(t.off);
+        out_ << "\n";
+        pipeline_.emplace(ws_, std::move(frames), 0, 1, opt_.ack, static_cast<size_t>(opt_.window),
+                          out_, out_, stats_, opt_.io_timeout);
+        pipeline_->start([this]{
+            if(pipeline_->error()){ ec_ = pipeline_->error(); return; }
+            rejected_ += pipeline_->rejected();
+            ++next_;
+            schedule();
+        });
+    }
+
+    ws_stream& ws_;
+    const Sequence& seq_;
+    const Options& opt_;
+    bool batch_, binary_;
+    std::ostream& out_;
+    PhaseStats* stats_;
+    net::steady_timer timer_;
+    std::optional<SetPipeline> pipeline_;
+    std::chrono::steady_clock::time_point start_, end_;
+    LatencyHistogram late_;
+    size_t next_=0, frames_=0, rejected_=0;
+    beast::error_code ec_;
+};
+
+// ── --diff 스냅샷 캐시 ────────────────────────────────────────────────────────
+// bank 당 한 줄: "kulgad-pins 2 <unix ms> <bank> <size> <64 hex, 바이트 i = 채널 8i..8i+7>"
+// unix ms 는 스냅샷을 실제로 get 한 시각. 캐시에서 읽은 스냅샷을 다시 쓸 때도 그대로 두므로
+// --diff 를 반복해도 ttl 이 늘어나지 않는다.
+static std::string pins_cache_path(const Options& opt, const std::string& host, const std::string& port){
+    if(!opt.cache.empty()) return opt.cache;
+    if(const char* dir = std::getenv("XDG_RUNTIME_DIR")) return std::string(dir) + "/kulgad-" + host + "_" + port + ".pins";
+    return "/tmp/kulgad-" + std::to_string(::getuid()) + "-" + host + "_" + port + ".pins";
+}
+
+static long long unix_ms_now(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// ttl 안에 저장된 스냅샷이 있으면 true, taken_ms 에 get 시각 (bank 중 가장 오래된 것).
+// 요청이 걸친 bank 가 하나라도 없으면 false (다시 get).
+// 다른 사용자가 만든 파일은 믿지 않는다 (심어 둔 "이미 on" 스냅샷으로 set 을 건너뛰게 할 수 있으므로).
+static bool load_pins_cache(const std::string& path, std::chrono::steady_clock::duration ttl,
+                            const ChannelRanges& channels, BankPins& pins, long long& taken_ms){
+    std::string text;
+    if(ttl.count()<=0 || !read_own_file(path, text)) return false;
+    std::istringstream f{text};
+    std::string magic, hex;
+    int version=0, bank=0, size=0;
+    long long stamp=0;
+    auto nibble = [](char c){ return std::isdigit(static_cast<unsigned char>(c)) ? c-'0' : (c>='a' && c<='f') ? c-'a'+10 : -1; };
+    BankPins cached;
+    long long oldest = 0;
+    while(f >> magic >> version >> stamp >> bank >> size >> hex){
+        if(magic!="kulgad-pins" || version!=2 || bank<0 || size<0 || size>ChannelSet::kChannels
+           || hex.size()!=ChannelSet::kChannels/4) return false;
+        long long age = unix_ms_now() - stamp;
+        if(age<0 || age>std::chrono::duration_cast<std::chrono::milliseconds>(ttl).count()) return false;
+        Pins p;
+        p.size = size;
+        p.bank = bank;
+        for(int i=0;i<ChannelSet::kChannels/8;++i){
+            int hi = nibble(hex[2*i]), lo = nibble(hex[2*i+1]);
+            if(hi<0 || lo<0) return false;
+            p.on.w[i>>3] |= std::uint64_t(hi<<4 | lo) << ((i&7)*8);
+        }
+        cached[bank] = p;
+        if(!oldest || stamp<oldest) oldest = stamp;
+    }
+    bool complete = true;
+    channels.for_each_bank([&](int b, const ChannelSet&){ complete = complete && cached.count(b); });
+    if(!complete) return false;
+    pins = std::move(cached);
+    taken_ms = oldest;
+    return true;
 }
 
-static void usage(){
-    std::cerr
-      << "Usage:\n"
-      << "  kulgad-cli [options] [channels]\n"
-      << "Options:\n"
-      << "  -s | --set        : set 모드 (채널 상태 변경)\n"
-      << "  -g | --get        : get 모드 (상태 조회)\n"
-      << "  -on | --on        : set 값 true\n"
-      << "  -off| --off       : set 값 false\n"
-      << "Channels:\n"
-      << "  all | A-B | A,B,C | 혼합 가능. (예: 1,2,3,7-9)\n";
+// taken_ms: 스냅샷을 get 한 시각. ttl 이 0 이면 읽지 않으므로 쓰지도 않는다.
+static void save_pins_cache(const std::string& path, const BankPins& pins, long long taken_ms,
+                            std::chrono::steady_clock::duration ttl){
+    if(ttl.count()<=0) return;
+    static const char hex[] = "0123456789abcdef";
+    const std::string stamp = std::to_string(taken_ms);
+    std::string body;
+    for(auto& [bank, p]: pins){
+        body += "kulgad-pins 2 " + stamp + " " + std::to_string(bank) + " " + std::to_string(p.size) + " ";
+        for(int i=0;i<ChannelSet::kChannels/8;++i){
+            unsigned b = static_cast<unsigned>(p.on.w[i>>3] >> ((i&7)*8)) & 0xff;
+            body += hex[b>>4];
+            body += hex[b&15];
+        }
+        body += '\n';
+    }
+    write_file_atomic(path, body, 0600);
 }
 
-static bool parse_channels_token(const std::string& token, std::vector<int>& out){
-    if(token.empty()){ std::cerr<<"Empty channel token.\n"; return false; }
-    std::string low = lower_copy(token);
-    if(low=="all"){
-        out.reserve(out.size()+256);
-        for(int ch=0; ch<=255; ++ch) out.push_back(ch);
+// 요청 채널 중 현재 상태가 목표와 다르거나 알 수 없는(size 밖, 받지 못한 bank) 채널
+static ChannelRanges diff_channels(const Request& req, const BankPins& cur){
+    ChannelRanges need;
+    req.channels.for_each_bank([&](int bank, const ChannelSet& chs){
+        auto it = cur.find(bank);
+        if(it==cur.end()){ need.add_bank(bank, chs); return; }
+        const Pins& p = it->second;
+        need.add_bank(bank, chs & ((req.val ? ~p.on : p.on) | ~ChannelSet::first_n(p.size)));
+    });
+    return need;
+}
+
+static void apply_set(BankPins& pins, const ChannelRanges& chs, bool val){
+    chs.for_each_bank([&](int bank, const ChannelSet& s){
+        auto it = pins.find(bank);
+        if(it==pins.end()) return;
+        if(val) it->second.on |= s;
+        else    it->second.on &= ~s;
+    });
+}
+
+static void print_verify(std::ostream& out, const Request& req, const ChannelRanges& bad, int retries){
+    const char* state = req.val ? "on" : "off";
+    if(bad.empty()){
+        out << "Verified: " << req.channels.count() << " channel(s) " << state;
+        if(retries) out << " after " << retries << " retr" << (retries==1 ? "y" : "ies");
+        out << "\n";
+    }else{
+        out << "Error: " << bad.count() << " channel(s) still not " << state << " after "
+            << retries << " retr" << (retries==1 ? "y" : "ies") << ": " << format_channels(bad) << "\n";
+    }
+}
+
+static void print_diff(std::ostream& out, const Request& req, const ChannelRanges& need){
+    long long skipped = req.channels.count() - need.count();
+    out << "Diff: " << skipped << " of " << req.channels.count() << " channel(s) already "
+        << (req.val ? "on" : "off") << ", sending " << need.count() << "\n";
+}
+
+// 컨트롤러 채널 수: --channels, 없으면 핸드셰이크 caps 의 channels=N, 둘 다 없으면 bank 하나(256)
+static int channel_space(const Options& opt, beast::string_view caps){
+    if(opt.channels>0) return opt.channels;
+    int n = cap_value(caps, "channels");
+    return n>0 ? std::min(n, kMaxChannels) : kBankChannels;
+}
+
+static void offer_binary(ws_stream& ws){
+    ws.set_option(websocket::stream_base::decorator([](websocket::request_type& req){
+        req.set(beast::http::field::sec_websocket_protocol, kBinaryProtocol);
+    }));
+}
+
+static bool accepted_binary(const websocket::response_type& res){
+    return beast::iequals(res[beast::http::field::sec_websocket_protocol], kBinaryProtocol);
+}
+
+// 연결 수립: resolve → 해석된 endpoint 를 차례로 connect (각각 connect_timeout) → TCP_NODELAY → handshake (io_timeout).
+// 모든 endpoint 가 실패하면 ±50% 지터를 섞은 backoff(매번 2배) 후 retries 번까지 처음 endpoint 부터 다시.
+// 시간 초과는 beast::error::timeout 으로 done 에 전달된다. ws 의 executor(strand 포함) 에서 동작.
+// resolve(getaddrinfo) 는 취소할 수 없으므로 따로 띄운 스레드에서 하고, 제한 시간이 지나거나 취소되면
+// 그 스레드를 버린다(결과가 와도 무시). 그래서 DNS 가 멈춰도 io_context 가 붙잡히지 않는다.
+class Connector{
+public:
+    Connector(ws_stream& ws, const Options& opt, std::string host, std::string port, PhaseStats* stats)
+      : ws_(ws), opt_(opt), host_(std::move(host)), port_(std::move(port)), stats_(stats),
+        timer_(ws.get_executor()), backoff_(opt.retry_backoff)
+    {}
+    ~Connector(){ abandon_resolve(); }
+
+    void start(std::function<void(beast::error_code)> done){
+        done_ = std::move(done);
+        t0_ = std::chrono::steady_clock::now();
+        if(stats_) stats_->attempted = true;
+        if(opt_.connect_timeout.count()>0){
+            timer_.expires_after(opt_.connect_timeout);
+            timer_.async_wait([this](beast::error_code ec){
+                if(ec || resolved_) return;
+                abandon_resolve();
+                finish(beast::error::timeout);
+            });
+        }
+        resolve_ = std::make_shared<Resolve>();
+        resolve_->work.emplace(ws_.get_executor());
+        std::thread([st=resolve_, host=host_, port=port_, this]{
+            net::io_context ctx;
+            tcp::resolver resolver{ctx};
+            beast::error_code ec;
+            auto eps = resolver.resolve(host, port, ec);
+            std::lock_guard<std::mutex> lock{st->m};
+            if(!st->work) return;
+            net::post(st->work->get_executor(), [st, this, ec, eps]{
+                if(st->abandoned) return;
+                on_resolved(ec, eps);
+            });
+            st->work.reset();
+        }).detach();
+    }
+
+    // 진행 중인 단계를 취소한다 (done 은 operation_aborted 로 불린다)
+    void cancel(){
+        cancelled_ = true;
+        timer_.cancel();
+        beast::get_lowest_layer(ws_).cancel();
+        if(!resolved_ && resolve_){
+            abandon_resolve();
+            finish(net::error::operation_aborted);
+        }
+    }
+
+    const websocket::response_type& response() const { return hres_; }
+
+private:
+    // resolve 스레드와 공유. work 가 남아 있는 동안 io_context 가 결과를 기다린다.
+    struct Resolve{
+        std::mutex m;
+        bool abandoned = false;
+        std::optional<net::executor_work_guard<net::any_io_executor>> work;
+    };
+
+    void abandon_resolve(){
+        if(!resolve_) return;
+        std::lock_guard<std::mutex> lock{resolve_->m};
+        resolve_->abandoned = true;
+        resolve_->work.reset();
+    }
+
+    void on_resolved(beast::error_code ec, const tcp::resolver::results_type& eps){
+        resolved_ = true;
+        timer_.cancel();
+        if(ec) return finish(ec);
+        if(stats_) stats_->lap(Phase::resolve, t0_);
+        eps_ = eps;
+        try_endpoint(eps_.begin());
+    }
+
+    void try_endpoint(tcp::resolver::results_type::const_iterator it){
+        if(it==eps_.end()) return retry();
+        auto& stream = beast::get_lowest_layer(ws_);
+        stream.close();
+        if(opt_.connect_timeout.count()>0) stream.expires_after(opt_.connect_timeout);
+        stream.async_connect(it->endpoint(), [this, it](beast::error_code ec){
+            if(ec){
+                if(cancelled_) return finish(ec);
+                last_ec_ = ec;
+                return try_endpoint(std::next(it));
+            }
+            if(stats_) stats_->lap(Phase::connect, t0_);
+            beast::get_lowest_layer(ws_).socket().set_option(tcp::no_delay(true));
+            handshake();
+        });
+    }
+
+    void retry(){
+        if(attempt_>=static_cast<int>(opt_.connect_retries)) return finish(last_ec_);
+        ++attempt_;
+        static thread_local std::minstd_rand rng{std::random_device{}()};
+        std::uniform_real_distribution<double> jitter{0.5, 1.5};
+        timer_.expires_after(std::chrono::duration_cast<std::chrono::steady_clock::duration>(backoff_*jitter(rng)));
+        backoff_ *= 2;
+        timer_.async_wait([this](beast::error_code ec){
+            if(ec) return finish(ec);
+            try_endpoint(eps_.begin());
+        });
+    }
+
+    void handshake(){
+        if(opt_.binary) offer_binary(ws_);
+        arm_timeout(ws_, opt_.io_timeout);
+        ws_.async_handshake(hres_, host_, "/", [this](beast::error_code ec){
+            beast::get_lowest_layer(ws_).expires_never();
+            if(ec) return finish(ec);
+            if(stats_) stats_->lap(Phase::handshake, t0_);
+            finish({});
+        });
+    }
+
+    void finish(beast::error_code ec){
+        if(auto done = std::move(done_)) done(ec);
+    }
+
+    ws_stream& ws_;
+    Options opt_;
+    std::string host_, port_;
+    PhaseStats* stats_;
+    std::shared_ptr<Resolve> resolve_;
+    net::steady_timer timer_;
+    tcp::resolver::results_type eps_;
+    websocket::response_type hres_;
+    std::function<void(beast::error_code)> done_;
+    std::chrono::steady_clock::time_point t0_;
+    std::chrono::steady_clock::duration backoff_;
+    beast::error_code last_ec_;
+    int attempt_=0;
+    bool resolved_=false, cancelled_=false;
+};
+
+// 컨트롤러와의 WebSocket 연결 하나. 데몬에서는 명령 사이에 계속 유지된다.
+class Session{
+public:
+    explicit Session(const Options& opt)
+      : opt_(opt), stats_(opt.stats ? &opt.stats->target(opt.host + ":" + opt.port) : nullptr) {}
+
+    bool is_open() const { return ws_ && ws_->is_open(); }
+
+    void connect(std::ostream& out){
+        ws_.reset();
+        ws_.emplace(ioc_);
+        Connector connector{*ws_, opt_, opt_.host, opt_.port, stats_};
+        beast::error_code ec;
+        connector.start([&ec](beast::error_code e){ ec = e; });
+        run_io();
+        if(ec) throw beast::system_error{ec};
+        const auto& hres = connector.response();
+        binary_ = opt_.binary && accepted_binary(hres);
+        ws_->binary(binary_);
+        batch_ = binary_ || has_cap(hres["X-Kulgad-Caps"], "batch");
+        space_ = channel_space(opt_, hres["X-Kulgad-Caps"]);
+        out << "Connected to " << opt_.host << ":" << opt_.port << "\n";
+    }
+
+    // 유휴 중에 도착한 push 프레임은 버린다. 서버가 연결을 끊었으면 false.
+    // 프레임 일부만 와 있을 수 있으므로 읽기는 io_timeout 안에 끝나야 한다 (넘으면 연결을 버림).
+    bool healthy(){
+        if(!is_open()) return false;
+        auto& sock = beast::get_lowest_layer(*ws_).socket();
+        pollfd pfd{sock.native_handle(), POLLIN, 0};
+        while(::poll(&pfd, 1, 0)>0){
+            if(pfd.revents & (POLLERR|POLLHUP)) return false;
+            if(sock.available()==0) return false;
+            beast::flat_buffer buf;
+            beast::error_code ec;
+            arm_timeout(*ws_, opt_.io_timeout);
+            ws_->async_read(buf, [&ec](beast::error_code e, std::size_t){ ec = e; });
+            run_io();
+            if(ec) return false;
+            beast::get_lowest_layer(*ws_).expires_never();
+        }
         return true;
     }
-    size_t pos=0;
-    while(pos<token.size()){
-        size_t comma = token.find(',', pos);
-        std::string part = token.substr(pos, (comma==std::string::npos)?std::string::npos:comma-pos);
-        if(part.empty()){ std::cerr<<"Invalid channel list near ','\n"; return false; }
-        size_t dash = part.find('-');
-        if(dash==std::string::npos){
-            if(!is_all_digits(part)){ std::cerr<<"Invalid channel: "<<part<<"\n"; return false; }
-            int ch = std::stoi(part);
-            if(ch<0 || ch>255){ std::cerr<<"Channel out of range: "<<ch<<"\n"; return false; }
-            out.push_back(ch);
-        }else{
-            std::string a_str = part.substr(0,dash), b_str = part.substr(dash+1);
-            if(!is_all_digits(a_str) || !is_all_digits(b_str)){ std::cerr<<"Invalid range: "<<part<<"\n"; return false; }
-            int a = std::stoi(a_str), b = std::stoi(b_str);
-            if(a>b) std::swap(a,b);
-            if(a<0 || b>255){ std::cerr<<"Range out of bounds: "<<part<<"\n"; return false; }
-            for(int ch=a; ch<=b; ++ch) out.push_back(ch);
+
+    void reset(){ ws_.reset(); }
+
+    // 연결한 컨트롤러의 채널 수
+    int channels() const { return space_; }
+
+    // 연결이 닫히거나 신호를 받을 때까지 변경 사항을 출력
+    int watch(ChannelRanges channels, std::chrono::steady_clock::duration interval, std::ostream& out){
+        if(!channels.clamp(space_, std::cerr)) return 1;
+        PinWatcher watcher{*ws_, channels, interval, out, binary_, opt_.io_timeout};
+        watcher.start();
+        run_io();
+        if(watcher.error()) throw beast::system_error{watcher.error()};
+        return 0;
+    }
+
+    int sequence(const Sequence& seq, std::ostream& out, std::ostream& err){
+        SequenceRunner runner{*ws_, seq, opt_, opt_.allow_batch && batch_, binary_, out, stats_};
+        runner.start();
+        run_io();
+        if(runner.error()) throw beast::system_error{runner.error()};
+        runner.report(out);
+        if(runner.rejected()){ err<<"Error: "<<runner.rejected()<<" set frame(s) rejected\n"; return 1; }
+        return 0;
+    }
+
+    void close(){
+        if(!is_open()) return;
+        auto t0 = std::chrono::steady_clock::now();
+        beast::error_code ec;
+        arm_timeout(*ws_, opt_.io_timeout);
+        ws_->async_close(websocket::close_code::normal, [&ec](beast::error_code e){ ec = e; });
+        run_io();
+        if(ec) throw beast::system_error{ec};
+        if(stats_) stats_->lap(Phase::close, t0);
+    }
+
+    // 선택이 걸친 bank 마다 get 을 연달아 보내고 응답을 bank 별로 모은다 (전송과 응답 각각 io_timeout).
+    // 모두 pins 를 담고 있으면 true, 아니면 false (raw 에 처음 받은 다른 응답의 원문)
+    bool get_pins(const ChannelRanges& chs, BankPins& pins, std::string& raw){
+        std::vector<std::string> gets;
+        chs.for_each_bank([&](int b, const ChannelSet&){ gets.push_back(get_payload(binary_, b)); });
+        pins.clear();
+        auto t0 = std::chrono::steady_clock::now(), sent = t0;
+        beast::error_code ec;
+        beast::flat_buffer buf;
+        size_t wrote=0, replies=0;
+        bool ok = true;
+        std::function<void()> write_next, read_next;
+        write_next = [&]{
+            if(wrote==gets.size()){
+                if(stats_) stats_->lap(Phase::write, t0);
+                return read_next();
+            }
+            arm_timeout(*ws_, opt_.io_timeout);
+            ws_->async_write(net::buffer(gets[wrote]), [&](beast::error_code e, std::size_t){
+                if((ec = e)) return;
+                ++wrote;
+                write_next();
+            });
+        };
+        read_next = [&]{
+            buf.consume(buf.size());
+            arm_timeout(*ws_, opt_.io_timeout);
+            ws_->async_read(buf, [&](beast::error_code e, std::size_t){
+                if((ec = e)) return;
+                Pins p;
+                if(decode_pins(buf, p)) pins[p.bank] = p;
+                else if(ok){ ok = false; raw = beast::buffers_to_string(buf.data()); }
+                if(++replies<gets.size()) read_next();
+            });
+        };
+        write_next();
+        run_io();
+        beast::get_lowest_layer(*ws_).expires_never();
+        if(ec) throw beast::system_error{ec};
+        if(stats_){ stats_->lap(Phase::read, t0); stats_->record(Phase::rtt, t0-sent); }
+        return ok;
+    }
+
+    // todo.channels 를 보내고 끝날 때까지 대기. 거부된 프레임 수를 반환
+    size_t send_set(const Request& todo, size_t& nframes, std::ostream& out, std::ostream& err){
+        auto frames = todo.channels.empty() ? std::vector<SetPipeline::Frame>{}
+                                            : build_set_frames(todo, opt_.allow_batch && batch_, binary_);
+        nframes = frames.size();
+        if(opt_.one_line) for(auto& f: frames) f.label.clear();
+        SetPipeline pipeline{*ws_, std::move(frames), opt_.rate, opt_.burst, opt_.ack,
+                             static_cast<size_t>(opt_.window), out, err, stats_, opt_.io_timeout};
+        pipeline.start();
+        run_io();
+        if(pipeline.error()) throw beast::system_error{pipeline.error()};
+        return pipeline.rejected();
+    }
+
+    // get 으로 확인하고 다른 채널만 backoff(매번 2배) 후 다시 보낸다. 끝까지 다른 채널을 반환.
+    // 재전송 중 거부된 프레임 수는 rejected 에 더한다.
+    // cur 와 taken_ms 는 마지막 get 결과와 그 시각으로 바뀐다
+    ChannelRanges verify_set(const Request& req, std::optional<BankPins>& cur, long long& taken_ms, int& retries,
+                             size_t& nframes, size_t& rejected, std::ostream& out, std::ostream& err){
+        auto backoff = opt_.verify_backoff;
+        for(retries=0;;++retries){
+            BankPins pins;
+            std::string raw;
+            taken_ms = unix_ms_now();
+            if(!get_pins(req.channels, pins, raw)){
+                err << "Warning: 'pins' array not found in verify readback.\n";
+                cur.reset();
+                return req.channels;
+            }
+            cur = pins;
+            ChannelRanges bad = diff_channels(req, pins);
+            if(bad.empty() || retries>=static_cast<int>(opt_.verify_retries)) return bad;
+            if(!opt_.one_line) out << "Verify: " << bad.count() << " channel(s) mismatched ("
+                                   << format_channels(bad) << "), resending\n";
+            std::this_thread::sleep_for(backoff);
+            backoff *= 2;
+            Request again = req;
+            again.channels = bad;
+            size_t n=0;
+            rejected += send_set(again, n, out, err);
+            nframes += n;
+        }
+    }
+
+    // set 이 거부되거나 --verify 가 불일치로 끝나도 요청한 get 은 수행하고 그 뒤에 종료 코드를 돌려준다
+    int run(Request req, std::ostream& out, std::ostream& err){
+        if(!req.channels.clamp(space_, err)) return 1;
+        int rc = 0;
+        if(req.set){
+            Request todo = req;
+            std::optional<BankPins> snapshot;
+            long long taken_ms = 0;
+            const std::string cache = opt_.diff ? pins_cache_path(opt_, opt_.host, opt_.port) : std::string();
+            if(opt_.diff){
+                BankPins cur;
+                std::string raw;
+                const bool cached = load_pins_cache(cache, opt_.cache_ttl, req.channels, cur, taken_ms);
+                if(!cached) taken_ms = unix_ms_now();
+                if(cached || get_pins(req.channels, cur, raw)){
+                    todo.channels = diff_channels(req, cur);
+                    snapshot = cur;
+                    if(!opt_.one_line) print_diff(out, req, todo.channels);
+                }else{
+                    err << "Warning: no pin snapshot for --diff, sending all channels\n";
+                }
+            }
+            size_t nframes=0, resend_rejected=0;
+            size_t rejected = send_set(todo, nframes, out, err);
+            if(rejected) err << "Error: " << rejected << " set frame(s) rejected\n";
+            else if(snapshot) apply_set(*snapshot, todo.channels, req.val);
+            ChannelRanges bad;
+            int retries=0;
+            if(opt_.verify && !rejected){
+                bad = verify_set(req, snapshot, taken_ms, retries, nframes, resend_rejected, out, err);
+                if(!opt_.one_line) print_verify(bad.empty() ? out : err, req, bad, retries);
+                if(resend_rejected) err << "Error: " << resend_rejected << " resent set frame(s) rejected\n";
+            }
+            if(snapshot && opt_.diff && !rejected) save_pins_cache(cache, *snapshot, taken_ms, opt_.cache_ttl);
+            if(opt_.one_line && !rejected){
+                out << "set " << format_channels(req.channels) << " " << (req.val ? "on" : "off") << ": "
+                    << (bad.empty() ? "ok" : "mismatch " + format_channels(bad))
+                    << " (" << nframes << " frame" << (nframes==1?"":"s");
+                if(opt_.diff) out << ", " << (req.channels.count()-todo.channels.count()) << " unchanged";
+                if(opt_.verify) out << ", " << (bad.empty() ? "verified" : "unverified");
+                if(retries) out << ", " << retries << " retr" << (retries==1 ? "y" : "ies");
+                if(resend_rejected) out << ", " << resend_rejected << " resend(s) rejected";
+                out << ")\n";
+            }
+            if(rejected) rc = 1;
+            else if(!bad.empty() || resend_rejected) rc = kExitMismatch;
+        }
+
+        if(req.get){
+            BankPins pins;
+            std::string raw;
+            if(!get_pins(req.channels, pins, raw)){
+                out << "Received (raw): " << raw << "\n";
+                err << "Warning: 'pins' array not found.\n";
+            }else{
+                print_status(out, req.channels, pins, opt_.one_line);
+            }
+        }
+        return rc;
+    }
+
+private:
+    void run_io(){
+        ioc_.run();
+        ioc_.restart();
+    }
+
+    Options opt_;
+    net::io_context ioc_;
+    PhaseStats* stats_;
+    std::optional<ws_stream> ws_;
+    bool batch_=false, binary_=false;
+    int space_=kBankChannels;
+};
+
+// "200ms", "1.5s", "500us", 단위 생략 시 ms. 음수, nan/inf, 1e9초 초과(steady_clock 범위 근처)는 거부
+static bool parse_duration(const std::string& text, std::chrono::steady_clock::duration& out){
+    size_t used=0;
+    double v=0;
+    try{ v = std::stod(text, &used); }catch(const std::exception&){ return false; }
+    std::string unit = lower_copy(text.substr(used));
+    double scale;
+    if(unit.empty() || unit=="ms") scale = 1e-3;
+    else if(unit=="s")             scale = 1;
+    else if(unit=="us")            scale = 1e-6;
+    else return false;
+    if(!(v>=0 && v*scale<=1e9)) return false;
+    out = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(v*scale));
+    return true;
+}
+
+// --seq 패턴. ';' 또는 줄바꿈으로 단계를 나누고 '#' 뒤는 주석. 시각은 모두 시퀀스 시작 기준.
+//   set <ch> on|off                채널을 한 번에 set
+//   pulse <ch> <width>             켜고 width 후 끔
+//   stagger <ch> on|off <step>     채널 번호 순서대로 step 간격으로 set
+//   chase <ch> <step> [width W]    채널 번호 순서대로 켰다가 W(기본 step) 후 끔
+// 공통 수식어: at T (시작 시각, 기본 0), every P times N (P 간격으로 N번 반복)
+//   예) "pulse 5 200ms; stagger 1-64 on 10ms at 1s; chase 100-107 50ms every 400ms times 5"
+// 문법만 검사해 seq.steps 를 채운다 (연결 전에 부른다). 채널 수에 달린 검사는 expand_sequence 에서.
+static constexpr auto kMaxSeqSpan = std::chrono::hours(24*365);
+
+static bool parse_sequence(const std::string& text, Sequence& seq, std::ostream& err){
+    using duration = std::chrono::steady_clock::duration;
+    seq.steps.clear();
+    int stepno = 0;
+    size_t pos = 0;
+    while(pos<=text.size()){
+        size_t end = text.find_first_of(";\n", pos);
+        if(end==std::string::npos) end = text.size();
+        std::string step = text.substr(pos, end-pos);
+        pos = end+1;
+        auto hash = step.find('#');
+        if(hash!=std::string::npos) step.erase(hash);
+        std::istringstream words{step};
+        std::string verb;
+        if(!(words >> verb)) continue;
+        verb = lower_copy(verb);
+        ++stepno;
+        auto bad = [&](const std::string& why){
+            err << "Invalid sequence step " << stepno << " (" << why << "): " << step << "\n";
+            return false;
+        };
+
+        duration at{}, every{}, width{};
+        bool have_width = false;
+        long long times = 1;
+        std::vector<std::string> args;
+        for(std::string w; words >> w;){
+            std::string low = lower_copy(w);
+            if(low=="at" || low=="every" || low=="width" || low=="times"){
+                std::string v;
+                if(!(words >> v)) return bad("missing value for " + low);
+                if(low=="times"){
+                    try{ times = std::stoll(v); }catch(const std::exception&){ times = 0; }
+                    if(times<1) return bad("times must be >= 1");
+                }else if(!parse_duration(v, low=="at" ? at : low=="every" ? every : width)){
+                    return bad("invalid duration " + v);
+                }
+                if(low=="width") have_width = true;
+                continue;
+            }
+            args.push_back(w);
+        }
+        if(times>1 && every.count()<=0) return bad("times needs every");
+
+        const size_t want = (verb=="set") ? 2 : (verb=="pulse") ? 2 : (verb=="stagger") ? 3 : (verb=="chase") ? 2 : 0;
+        if(!want) return bad("unknown step " + verb);
+        if(args.size()!=want) return bad("expected " + std::to_string(want) + " argument(s)");
+        SeqStep st;
+        st.no = stepno;
+        st.text = step;
+        st.verb = verb;
+        std::ostringstream perr;
+        if(!parse_channels_token(args[0], st.chs, perr)) return bad(perr.str().substr(0, perr.str().find('\n')));
+        if(verb=="set" || verb=="stagger"){
+            std::string v = lower_copy(args[1]);
+            if(v!="on" && v!="off") return bad("expected on or off");
+            st.val = (v=="on");
+        }
+        if(verb=="pulse" && !parse_duration(args[1], width)) return bad("invalid duration " + args[1]);
+        if((verb=="stagger" || verb=="chase") && !parse_duration(args[want-1], st.step_len)) return bad("invalid duration " + args[want-1]);
+        if(verb=="chase" && !have_width) width = st.step_len;
+        // 마지막 이벤트 시각 at + every*(times-1) + step*(채널 수-1) + width 가 넘치지 않도록 각 항을 제한
+        // (채널 수 항은 "all" 이 정해지는 expand_sequence 에서)
+        if(at>kMaxSeqSpan || width>kMaxSeqSpan || (every.count()>0 && times-1 > kMaxSeqSpan/every))
+            return bad("sequence longer than 365 days");
+        st.at = at;
+        st.every = every;
+        st.width = width;
+        st.times = times;
+        seq.steps.push_back(std::move(st));
+    }
+    if(seq.steps.empty()){ err << "Empty sequence\n"; return false; }
+    return true;
+}
+
+// 연결한 컨트롤러의 채널 수(channels)에 맞춰 "all" 을 닫고 단계를 이벤트로 펼친 뒤 tick 별로 합친다
+static bool expand_sequence(Sequence& seq, int channels, std::ostream& err){
+    using duration = std::chrono::steady_clock::duration;
+    struct Event{ duration at; ChannelRanges chs; bool val; };
+    constexpr size_t kMaxEvents = 1000000;
+    std::vector<Event> events;
+
+    for(const auto& st: seq.steps){
+        auto bad = [&](const std::string& why){
+            err << "Invalid sequence step " << st.no << " (" << why << "): " << st.text << "\n";
+            return false;
+        };
+        const std::string& verb = st.verb;
+        const duration at = st.at, every = st.every, width = st.width, step_len = st.step_len;
+        const long long times = st.times;
+        const bool val = st.val;
+        ChannelRanges chs = st.chs;
+        std::ostringstream perr;
+        if(!chs.clamp(channels, perr)) return bad(perr.str().substr(0, perr.str().find('\n')));
+
+        if(static_cast<size_t>(chs.count())*2 > (kMaxEvents-events.size())/static_cast<size_t>(times)) return bad("too many events");
+        const long long last = chs.count()-1;
+        if(step_len.count()>0 && last > kMaxSeqSpan/step_len) return bad("sequence longer than 365 days");
+        for(long long r=0;r<times;++r){
+            duration base = at + every*r;
+            if(verb=="set") events.push_back({base, chs, val});
+            else if(verb=="pulse"){
+                events.push_back({base, chs, true});
+                events.push_back({base+width, chs, false});
+            }else{
+                long long k = 0;
+                chs.for_each([&](int ch){
+                    ChannelRanges one;
+                    one.add(ch, ch);
+                    duration t = base + step_len*k++;
+                    if(verb=="stagger") events.push_back({t, one, val});
+                    else{
+                        events.push_back({t, one, true});
+                        events.push_back({t+width, one, false});
+                    }
+                });
+            }
         }
-        if(comma==std::string::npos) break;
-        pos = comma + 1;
     }
+    if(events.empty()){ err << "Empty sequence\n"; return false; }
+
+    // tick 으로 반올림해 같은 tick 끼리 합친다 (같은 tick 안에서는 정의 순서대로 적용)
+    auto tick_of = [&](duration d){ return static_cast<long long>(std::llround(double(d.count())/seq.tick.count())); };
+    std::stable_sort(events.begin(), events.end(), [&](const Event& a, const Event& b){ return tick_of(a.at)<tick_of(b.at); });
+    seq.ticks.clear();
+    for(const auto& e: events){
+        long long t = tick_of(e.at);
+        if(seq.ticks.empty() || seq.ticks.back().tick!=t) seq.ticks.push_back({t, {}, {}});
+        auto& cur = seq.ticks.back();
+        if(e.val){ cur.on.add(e.chs); cur.off.subtract(e.chs); }
+        else     { cur.off.add(e.chs); cur.on.subtract(e.chs); }
+    }
+    seq.events = events.size();
     return true;
 }
 
-static std::vector<bool> parse_pins_from_json(const std::string& js){
-    std::vector<bool> pins;
-    auto p = js.find("\"pins\""); if(p==std::string::npos) return pins;
-    auto lb=js.find('[',p); if(lb==std::string::npos) return pins;
-    auto rb=js.find(']',lb); if(rb==std::string::npos) return pins;
-    std::string arr = js.substr(lb+1, rb-lb-1);
-    for(size_t i=0;i<arr.size();++i){
-        if(i+4<=arr.size() && arr.compare(i,4,"true")==0){ pins.push_back(true);  i+=3; }
-        else if(i+5<=arr.size()&&arr.compare(i,5,"false")==0){ pins.push_back(false); i+=4; }
+// --script/--stdin: 한 줄씩 읽어 하나의 세션에서 순서대로 실행.
+//   set <channels> on|off / get <channels> / sleep <duration> / # 주석
+// 첫 오류에서 멈추고 해당 명령의 종료 코드를 돌려준다.
+static int run_script(Session& session, std::istream& in, const std::string& name){
+    int lineno = 0;
+    for(std::string line; std::getline(in, line);){
+        ++lineno;
+        auto hash = line.find('#');
+        if(hash!=std::string::npos) line.erase(hash);
+        std::istringstream words{line};
+        std::string verb;
+        if(!(words >> verb)) continue;
+
+        if(lower_copy(verb)=="sleep"){
+            std::string arg, extra;
+            std::chrono::steady_clock::duration d{};
+            if(!(words >> arg) || (words >> extra) || !parse_duration(arg, d)){
+                std::cerr << name << ":" << lineno << ": invalid sleep: " << line << "\n";
+                return 1;
+            }
+            std::this_thread::sleep_for(d);
+            continue;
+        }
+
+        Request req;
+        std::ostringstream perr;
+        if(!parse_request_line(line, req, perr)){
+            std::cerr << name << ":" << lineno << ": " << perr.str();
+            return 1;
+        }
+        int rc = session.run(req, std::cout, std::cerr);
+        std::cout << std::flush;
+        if(rc!=0) return rc;
     }
-    return pins;
+    return 0;
 }
 
-int main(int argc, char** argv){
-    try{
-        const std::string host = "localhost";
-        const std::string port = "3001";
+struct Target{ std::string host, port; };
+
+// "host:port", "host" (포트 3001), "[v6addr]:port"
+static bool parse_target(const std::string& text, Target& t){
+    std::string host = text, port = "3001";
+    if(!text.empty() && text[0]=='['){
+        auto rb = text.find(']');
+        if(rb==std::string::npos) return false;
+        host = text.substr(1, rb-1);
+        if(rb+1<text.size()){
+            if(text[rb+1]!=':') return false;
+            port = text.substr(rb+2);
+        }
+    }else{
+        auto colon = text.rfind(':');
+        if(colon!=std::string::npos){ host = text.substr(0, colon); port = text.substr(colon+1); }
+    }
+    if(host.empty() || port.empty() || !std::all_of(port.begin(), port.end(), [](unsigned char c){ return std::isdigit(c)!=0; }))
+        return false;
+    t = Target{host, port};
+    return true;
+}
 
+// 같은 host:port 가 두 번 나오면 뒤의 것은 버린다. 한 대상은 한 strand 에서만 기록하고
+// (PhaseStats) 캐시 파일도 대상마다 하나이므로, 같은 대상에 두 작업을 띄우면 안 된다.
+static void add_target(std::vector<Target>& targets, Target t){
+    for(const auto& o: targets){
+        if(beast::iequals(o.host, t.host) && o.port==t.port){
+            std::cerr << "Warning: duplicate target " << t.host << ":" << t.port << " ignored\n";
+            return;
+        }
+    }
+    targets.push_back(std::move(t));
+}
+
+// 대상 목록 파일: 한 줄에 host:port 하나, # 주석
+static bool load_targets(const std::string& path, std::vector<Target>& out){
+    std::ifstream in{path};
+    if(!in){ std::cerr<<"Cannot open target list: "<<path<<"\n"; return false; }
+    int lineno = 0;
+    for(std::string line; std::getline(in, line);){
+        ++lineno;
+        auto hash = line.find('#');
+        if(hash!=std::string::npos) line.erase(hash);
+        std::istringstream words{line};
+        std::string word;
+        while(words >> word){
+            Target t;
+            if(!parse_target(word, t)){ std::cerr<<path<<":"<<lineno<<": invalid target: "<<word<<"\n"; return false; }
+            add_target(out, std::move(t));
+        }
+    }
+    return true;
+}
+
+// 여러 컨트롤러 중 하나에 대한 요청. 대상마다 strand 하나에서
+// resolve → connect → handshake → set → get → close 를 비동기로 진행하고,
+// 전체가 timeout 안에 끝나지 않으면 소켓을 닫아 중단한다. 출력은 모아 두었다가 main 이 찍는다.
+class FleetJob{
+public:
+    FleetJob(net::io_context& ioc, const Options& opt, Target target, const Request& req,
+             std::chrono::steady_clock::duration timeout)
+      : opt_(opt), target_(std::move(target)), req_(req), timeout_(timeout),
+        stats_(opt.stats ? &opt.stats->target(target_.host + ":" + target_.port) : nullptr),
+        strand_(net::make_strand(ioc)), ws_(strand_), connector_(ws_, opt_, target_.host, target_.port, stats_),
+        deadline_(strand_), retry_(strand_), backoff_(opt.verify_backoff)
+    {}
+
+    void start(){
+        net::dispatch(strand_, [this]{
+            started_ = phase_start_ = std::chrono::steady_clock::now();
+            deadline_.expires_after(timeout_);
+            deadline_.async_wait([this](beast::error_code ec){
+                if(ec || done_) return;
+                timed_out_ = true;
+                connector_.cancel();
+                retry_.cancel();
+                beast::get_lowest_layer(ws_).close();
+            });
+            connector_.start([this](beast::error_code ec){
+                if(ec) return finish(ec);
+                on_connected();
+            });
+        });
+    }
+
+    const Target& target() const { return target_; }
+    int result() const { return rc_; }
+    std::string output() const { return out_.str(); }
+    double elapsed_ms() const { return elapsed_ms_; }
+
+private:
+    void on_connected(){
+        const auto& hres = connector_.response();
+        binary_ = opt_.binary && accepted_binary(hres);
+        batch_ = binary_ || has_cap(hres["X-Kulgad-Caps"], "batch");
+        ws_.binary(binary_);
+        out_ << "Connected\n";
+        if(!req_.channels.clamp(channel_space(opt_, hres["X-Kulgad-Caps"]), out_)){
+            rc_ = 1;
+            return do_close();
+        }
+        if(!req_.set) return do_get();
+        if(!opt_.diff) return start_set();
+        cache_ = pins_cache_path(opt_, target_.host, target_.port);
+        BankPins cur;
+        if(load_pins_cache(cache_, opt_.cache_ttl, req_.channels, cur, snapshot_ms_)) return start_set(&cur);
+        snapshot_ms_ = unix_ms_now();
+        async_get([this](const BankPins* cur){
+            if(!cur) out_ << "Warning: no pin snapshot for --diff, sending all channels\n";
+            start_set(cur);
+        });
+    }
+
+    // cur 가 있으면(--diff) 목표 상태와 다른 채널만 보낸다
+    void start_set(const BankPins* cur = nullptr){
+        ChannelRanges todo = req_.channels;
+        if(cur){
+            todo = diff_channels(req_, *cur);
+            snapshot_ = *cur;
+            print_diff(out_, req_, todo);
+        }
+        send_set(todo, [this, todo]{
+            if(pipeline_->rejected()){
+                out_ << "Error: " << pipeline_->rejected() << " set frame(s) rejected\n";
+                rc_ = 1;
+                return do_get();
+            }
+            if(snapshot_) apply_set(*snapshot_, todo, req_.val);
+            if(opt_.verify) return do_verify();
+            if(snapshot_) save_pins_cache(cache_, *snapshot_, snapshot_ms_, opt_.cache_ttl);
+            do_get();
+        });
+    }
+
+    void send_set(const ChannelRanges& chs, std::function<void()> next){
+        Request todo = req_;
+        todo.channels = chs;
+        auto frames = chs.empty() ? std::vector<SetPipeline::Frame>{}
+                    : build_set_frames(todo, opt_.allow_batch && batch_, binary_);
+        pipeline_.emplace(ws_, std::move(frames), opt_.rate, opt_.burst, opt_.ack,
+                          static_cast<size_t>(opt_.window), out_, out_, stats_, opt_.io_timeout);
+        pipeline_->start([this, next=std::move(next)]{
+            if(pipeline_->error()) return finish(pipeline_->error());
+            next();
+        });
+    }
+
+    // get 으로 확인하고 다른 채널만 backoff(매번 2배) 후 다시 보낸다
+    void do_verify(){
+        const long long taken_ms = unix_ms_now();
+        async_get([this, taken_ms](const BankPins* cur){
+            ChannelRanges bad = cur ? diff_channels(req_, *cur) : req_.channels;
+            if(cur && opt_.diff) save_pins_cache(cache_, *cur, taken_ms, opt_.cache_ttl);
+            if(bad.empty() || !cur || retries_>=static_cast<int>(opt_.verify_retries)){
+                print_verify(out_, req_, bad, retries_);
+                if(resend_rejected_) out_ << "Error: " << resend_rejected_ << " resent set frame(s) rejected\n";
+                if(!bad.empty() || resend_rejected_) rc_ = kExitMismatch;
+                return do_get();
+            }
+            out_ << "Verify: " << bad.count() << " channel(s) mismatched (" << format_channels(bad) << "), resending\n";
+            retry_.expires_after(backoff_);
+            backoff_ *= 2;
+            ++retries_;
+            retry_.async_wait([this, bad](beast::error_code ec){
+                if(ec) return finish(ec);
+                send_set(bad, [this]{
+                    resend_rejected_ += pipeline_->rejected();
+                    do_verify();
+                });
+            });
+        });
+    }
+
+    // 선택이 걸친 bank 마다 get 을 연달아 보내고 응답을 bank 별로 모은다.
+    // pins 배열이 없는 응답이 있으면 원문을 남기고 next(nullptr)
+    void async_get(std::function<void(const BankPins*)> next){
+        gets_.clear();
+        req_.channels.for_each_bank([&](int b, const ChannelSet&){ gets_.push_back(get_payload(binary_, b)); });
+        got_.clear();
+        raw_.clear();
+        replies_ = 0;
+        get_next_ = std::move(next);
+        phase_start_ = get_sent_ = std::chrono::steady_clock::now();
+        write_get(0);
+    }
+
+    void write_get(size_t i){
+        if(i==gets_.size()){
+            lap(Phase::write);
+            return read_get();
+        }
+        arm_timeout(ws_, opt_.io_timeout);
+        ws_.async_write(net::buffer(gets_[i]), [this, i](beast::error_code ec, std::size_t){
+            if(ec) return finish(ec);
+            write_get(i+1);
+        });
+    }
+
+    void read_get(){
+        buf_.consume(buf_.size());
+        arm_timeout(ws_, opt_.io_timeout);
+        ws_.async_read(buf_, [this](beast::error_code ec, std::size_t){
+            if(ec) return finish(ec);
+            Pins pins;
+            if(decode_pins(buf_, pins)) got_[pins.bank] = pins;
+            else if(raw_.empty()) raw_ = beast::buffers_to_string(buf_.data());
+            if(++replies_<gets_.size()) return read_get();
+            beast::get_lowest_layer(ws_).expires_never();
+            lap(Phase::read);
+            if(stats_) stats_->record(Phase::rtt, phase_start_-get_sent_);
+            auto next = std::move(get_next_);
+            if(raw_.empty()) return next(&got_);
+            out_ << "Received (raw): " << raw_ << "\n"
+                 << "Warning: 'pins' array not found.\n";
+            next(nullptr);
+        });
+    }
+
+    void do_get(){
+        if(!req_.get) return do_close();
+        async_get([this](const BankPins* pins){
+            if(pins) print_status(out_, req_.channels, *pins, opt_.one_line);
+            do_close();
+        });
+    }
+
+    void do_close(){
+        phase_start_ = std::chrono::steady_clock::now();
+        arm_timeout(ws_, opt_.io_timeout);
+        ws_.async_close(websocket::close_code::normal, [this](beast::error_code ec){
+            if(!ec) lap(Phase::close);
+            finish({});
+        });
+    }
+
+    void lap(Phase p){ if(stats_) stats_->lap(p, phase_start_); }
+
+    void finish(beast::error_code ec){
+        if(done_) return;
+        done_ = true;
+        deadline_.cancel();
+        elapsed_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-started_).count();
+        if(timed_out_){ out_ << "Error: timed out\n"; rc_ = kExitTimeout; }
+        else if(ec){ out_ << "Error: " << ec.message() << "\n"; rc_ = exit_code_for(ec); }
+    }
+
+    Options opt_;
+    Target target_;
+    Request req_;
+    std::chrono::steady_clock::duration timeout_;
+    PhaseStats* stats_;
+    net::strand<net::io_context::executor_type> strand_;
+    ws_stream ws_;
+    Connector connector_;
+    net::steady_timer deadline_, retry_;
+    std::chrono::steady_clock::duration backoff_;
+    int retries_=0;
+    size_t resend_rejected_=0;
+    std::optional<SetPipeline> pipeline_;
+    std::optional<BankPins> snapshot_;
+    long long snapshot_ms_=0;   // snapshot_ 을 get 한 시각 (unix ms)
+    std::string cache_;
+    bool binary_=false, batch_=false;
+    std::vector<std::string> gets_;     // 진행 중인 get 프레임 (bank 별)
+    BankPins got_;
+    std::string raw_;
+    size_t replies_=0;
+    std::function<void(const BankPins*)> get_next_;
+    beast::flat_buffer buf_;
+    std::ostringstream out_;
+    std::chrono::steady_clock::time_point started_, phase_start_, get_sent_;
+    double elapsed_ms_ = 0;
+    bool done_=false, timed_out_=false;
+    int rc_=0;
+};
+
+// 모든 대상에 동시에 요청하고 대상 순서대로 "[host:port] ..." 형태로 결과를 모아 출력
+static int run_fleet(const Options& opt, const std::vector<Target>& targets, const Request& req,
+                     std::chrono::steady_clock::duration timeout, unsigned threads){
+    net::io_context ioc;
+    std::vector<std::unique_ptr<FleetJob>> jobs;
+    jobs.reserve(targets.size());
+    for(const auto& t: targets){
+        jobs.push_back(std::make_unique<FleetJob>(ioc, opt, t, req, timeout));
+        jobs.back()->start();
+    }
+    std::vector<std::thread> pool;
+    for(unsigned i=1;i<threads;++i) pool.emplace_back([&ioc]{ ioc.run(); });
+    ioc.run();
+    for(auto& th: pool) th.join();
+
+    // 실패한 대상들의 종료 코드가 모두 같으면 그 코드, 섞여 있으면 1
+    int failed = 0, rc = 0;
+    for(const auto& job: jobs){
+        std::string name = job->target().host + ":" + job->target().port;
+        std::istringstream lines{job->output()};
+        for(std::string line; std::getline(lines, line);) std::cout << "[" << name << "] " << line << "\n";
+        if(job->result()==0) continue;
+        rc = (failed && rc!=job->result()) ? 1 : job->result();
+        ++failed;
+    }
+    std::cout << "Targets: " << (jobs.size()-failed) << " ok, " << failed << " failed\n";
+    return rc;
+}
+
+static std::string default_socket_path(){
+    if(const char* p = std::getenv("KULGAD_SOCKET")) return p;
+    if(const char* d = std::getenv("XDG_RUNTIME_DIR")) return std::string(d) + "/kulgad-cli.sock";
+    return "/tmp/kulgad-cli-" + std::to_string(::getuid()) + ".sock";
+}
+
+// 데몬 프로토콜: 클라이언트는 명령 줄들 뒤에 빈 줄 하나를 보낸다 (쓰기 쪽을 닫아도 끝으로 본다).
+// 데몬은 실행을 시작할 때 "%start" 를 보내고(클라이언트가 이미 떠났으면 실행하지 않음), 출력 줄을 그대로,
+// 오류 출력 줄은 "%err " 를 붙여 보내며 마지막 줄 "%exit N"이 종료 코드.
+static constexpr size_t kMaxDaemonRequest = 64*1024;
+
+// 데몬이 떠 있으면 요청 줄을 보내고 응답을 stdout/stderr 로 나눠 출력한다.
+// 연결이나 요청 전송이 실패하면(timeout 포함) -1 을 돌려 직접 연결하게 한다. 요청을 보낸 뒤에는
+// 데몬이 실행할 수 있으므로 다시 보내지 않는다: timeout 안에 "%start" 가 없으면(멈췄거나 다른 요청 처리 중)
+// kExitTimeout, 시작한 뒤에는 끝날 때까지 기다린다 (데몬 쪽 I/O 는 각자 제한 시간이 있다).
+static int forward_to_daemon(const std::string& path, const std::string& lines,
+                             std::chrono::steady_clock::duration timeout){
+    net::io_context ioc;
+    local::stream_protocol::socket sock{ioc};
+    net::steady_timer deadline{ioc};
+    const std::string request = lines + "\n";
+    std::string buf;
+    beast::error_code ec;
+    bool written=false, started=false, expired=false;
+    int rc = -1;
+
+    if(timeout.count()>0){
+        deadline.expires_after(timeout);
+        deadline.async_wait([&](beast::error_code e){
+            if(e) return;
+            expired = true;
+            beast::error_code ignored;
+            sock.close(ignored);
+        });
+    }
+    std::function<void()> read_line = [&]{
+        net::async_read_until(sock, net::dynamic_buffer(buf), '\n', [&](beast::error_code e, std::size_t n){
+            if(e){ ec = e; deadline.cancel(); return; }
+            std::string line = buf.substr(0, n-1);
+            buf.erase(0, n);
+            if(line.compare(0, 6, "%exit ")==0){ rc = std::atoi(line.c_str()+6); deadline.cancel(); return; }
+            if(line=="%start"){
+                started = true;
+                deadline.cancel();
+            }else if(line.compare(0, 5, "%err ")==0) std::cerr << line.substr(5) << "\n";
+            else std::cout << line << "\n";
+            read_line();
+        });
+    };
+    sock.async_connect(local::stream_protocol::endpoint{path}, [&](beast::error_code e){
+        if(e){ ec = e; deadline.cancel(); return; }
+        net::async_write(sock, net::buffer(request), [&](beast::error_code e, std::size_t){
+            if(e){ ec = e; deadline.cancel(); return; }
+            written = true;
+            read_line();
+        });
+    });
+    ioc.run();
+
+    if(rc>=0) return rc;
+    if(!written){
+        if(expired) std::cerr << "Warning: daemon did not take the request in time, connecting directly\n";
+        return -1;
+    }
+    if(expired && !started){
+        std::cerr << "Error: daemon did not start the request within --timeout (busy or stopped)\n";
+        return kExitTimeout;
+    }
+    std::cerr << "Error: daemon closed the connection\n";
+    return 1;
+}
+
+static std::string g_daemon_socket;
+static void on_daemon_signal(int){
+    ::unlink(g_daemon_socket.c_str());
+    std::_Exit(0);
+}
+
+// 응답에 출력 텍스트를 줄 단위로 붙인다 (오류 출력은 prefix "%err ")
+static void append_reply(std::string& reply, const std::string& text, const char* prefix){
+    std::istringstream lines{text};
+    for(std::string line; std::getline(lines, line);) reply += prefix + line + "\n";
+}
+
+// 한 줄 명령 실행. 연결이 끊겼으면 다시 연결하고, 실행 중 I/O 오류가 나면 한 번 재시도한다.
+static int daemon_serve_line(Session& session, const std::string& line, std::string& reply){
+    Request req;
+    std::ostringstream parse_err;
+    if(!parse_request_line(line, req, parse_err)){ append_reply(reply, parse_err.str(), "%err "); return 1; }
+    for(int attempt=0;; ++attempt){
+        std::ostringstream out, err;
+        int rc = 0;
+        try{
+            if(!session.healthy()) session.connect(std::cout);
+            rc = session.run(req, out, err);
+        }catch(const beast::system_error& e){
+            session.reset();
+            if(attempt<1){ std::cout << "Reconnecting after error: " << e.what() << "\n" << std::flush; continue; }
+            err << "Error: " << e.what() << "\n";
+            rc = exit_code_for(e.code());
+        }catch(const std::exception& e){
+            session.reset();
+            if(attempt<1){ std::cout << "Reconnecting after error: " << e.what() << "\n" << std::flush; continue; }
+            err << "Error: " << e.what() << "\n";
+            rc = 1;
+        }
+        append_reply(reply, out.str(), "");
+        append_reply(reply, err.str(), "%err ");
+        return rc;
+    }
+}
+
+// 데몬 소켓 서버. 접속과 요청 읽기는 비동기라 느린(또는 멈춘) 클라이언트가 다른 클라이언트를 막지 않는다.
+// 명령 실행은 컨트롤러 연결 하나를 공유하므로 요청 단위로 차례로 한다.
+// io_timeout: 클라이언트가 요청을 다 보내는 데, 그리고 응답을 다 받아 가는 데 각각 주는 시간 (0=무제한)
+class DaemonServer{
+public:
+    DaemonServer(net::io_context& ioc, const local::stream_protocol::endpoint& ep, Session& session,
+                 std::chrono::steady_clock::duration io_timeout)
+      : ioc_(ioc), acceptor_(ioc, ep), timer_(ioc), session_(session), io_timeout_(io_timeout) {}
+
+    void start(){ accept(); }
+
+private:
+    struct Client{
+        explicit Client(net::io_context& ioc): sock(ioc), deadline(ioc) {}
+        local::stream_protocol::socket sock;
+        net::steady_timer deadline;
+        std::string buf, reply;
+        std::vector<std::string> lines;
+    };
+    using ClientPtr = std::shared_ptr<Client>;
+
+    // 제한 시간이 지나면 소켓을 닫아 진행 중인 읽기/쓰기를 끝낸다
+    void arm(const ClientPtr& c){
+        if(io_timeout_.count()<=0) return;
+        c->deadline.expires_after(io_timeout_);
+        c->deadline.async_wait([c](beast::error_code ec){
+            if(ec) return;
+            beast::error_code ignored;
+            c->sock.close(ignored);
+        });
+    }
+
+    void accept(){
+        auto c = std::make_shared<Client>(ioc_);
+        acceptor_.async_accept(c->sock, [this, c](beast::error_code ec){
+            if(!ec){ arm(c); read(c); return accept(); }
+            // fd 부족 등은 잠시 쉬고 다시 (바로 다시 부르면 같은 오류로 바쁜 루프)
+            std::cerr << "Warning: accept: " << ec.message() << "\n";
+            timer_.expires_after(std::chrono::milliseconds(100));
+            timer_.async_wait([this](beast::error_code){ accept(); });
+        });
+    }
+
+    void read(const ClientPtr& c){
+        net::async_read_until(c->sock, net::dynamic_buffer(c->buf, kMaxDaemonRequest), '\n',
+                              [this, c](beast::error_code ec, std::size_t n){
+            if(ec==net::error::eof){
+                if(!c->buf.empty()) c->lines.push_back(std::move(c->buf));
+                return serve(c);
+            }
+            if(ec) return;   // 너무 긴 요청이나 끊긴 연결: 응답 없이 닫는다
+            std::string line = c->buf.substr(0, n-1);
+            c->buf.erase(0, n);
+            if(line.empty()) return serve(c);
+            c->lines.push_back(std::move(line));
+            read(c);
+        });
+    }
+
+    void serve(const ClientPtr& c){
+        c->deadline.cancel();
+        // 기다리다 떠난 클라이언트(timeout)의 요청은 실행하지 않는다. 짧은 줄이라 소켓 버퍼에 바로 들어간다.
+        beast::error_code ec;
+        net::write(c->sock, net::buffer(std::string("%start\n")), ec);
+        if(ec) return;
+        int rc = 0;
+        for(const auto& line: c->lines){
+            rc = daemon_serve_line(session_, line, c->reply);
+            if(rc) break;
+        }
+        c->reply += "%exit " + std::to_string(rc) + "\n";
+        std::cout << std::flush;
+        arm(c);
+        net::async_write(c->sock, net::buffer(c->reply), [c](beast::error_code, std::size_t){
+            c->deadline.cancel();
+            beast::error_code ignored;
+            c->sock.shutdown(local::stream_protocol::socket::shutdown_both, ignored);
+        });
+    }
+
+    net::io_context& ioc_;
+    local::stream_protocol::acceptor acceptor_;
+    net::steady_timer timer_;
+    Session& session_;
+    std::chrono::steady_clock::duration io_timeout_;
+};
+
+static int run_daemon(const Options& opt, const std::string& path){
+    net::io_context ioc;
+    local::stream_protocol::endpoint ep{path};
+    {
+        local::stream_protocol::socket probe{ioc};
+        beast::error_code ec;
+        probe.connect(ep, ec);
+        if(!ec){ std::cerr<<"Daemon already running on "<<path<<"\n"; return 1; }
+        ::unlink(path.c_str());
+    }
+    Session session{opt};
+    DaemonServer server{ioc, ep, session, opt.io_timeout};
+    ::chmod(path.c_str(), 0600);
+    g_daemon_socket = path;
+    std::signal(SIGINT, on_daemon_signal);
+    std::signal(SIGTERM, on_daemon_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cout << "Listening on " << path << "\n" << std::flush;
+
+    try{ session.connect(std::cout); }
+    catch(const std::exception& e){ std::cerr << "Warning: " << e.what() << " (will retry on first command)\n"; }
+    std::cout << std::flush;
+
+    server.start();
+    ioc.run();
+    return 1;
+}
+
+// --stats 출력 설정. 계측 결과는 종료 직전에 한 번 내보낸다.
+struct StatsOutput{
+    bool summary = false;
+    std::string json, prom;
+    bool enabled() const { return summary || !json.empty() || !prom.empty(); }
+};
+static Stats g_stats;
+static StatsOutput g_stats_out;
+
+static void emit_stats(){
+    if(g_stats_out.summary) g_stats.print(std::cerr);
+    if(!g_stats_out.json.empty()){
+        std::ostringstream os;
+        g_stats.write_json(os);
+        if(!write_file_atomic(g_stats_out.json, os.str())) std::cerr << "Warning: cannot write " << g_stats_out.json << "\n";
+    }
+    if(!g_stats_out.prom.empty()){
+        std::ostringstream os;
+        g_stats.write_prometheus(os);
+        if(!write_file_atomic(g_stats_out.prom, os.str())) std::cerr << "Warning: cannot write " << g_stats_out.prom << "\n";
+    }
+}
+
+static int cli_main(int argc, char** argv){
+    try{
+        Options opt;
         bool want_set=false, want_get=false;
         bool have_val=false, val=false;
+        bool daemon=false, direct=false;
+        std::string script, seq_text;
+        bool watch=false;
+        Sequence seq;
+        std::vector<Target> targets;
+        std::chrono::steady_clock::duration timeout = std::chrono::seconds(10);
+        double threads = 0;
+        double channels = 0;
+        std::chrono::steady_clock::duration interval = std::chrono::seconds(1);
+        std::string sock_path = default_socket_path();
         std::vector<std::string> chanSpecs;
 
         if(argc<2){ usage(); return 1; }
@@ -122,6 +2855,67 @@ int main(int argc, char** argv){
 
             if(low=="-s" || low=="--set"){ want_set=true; continue; }
             if(low=="-g" || low=="--get"){ want_get=true; continue; }
+            if(low=="--no-batch"){ opt.allow_batch=false; continue; }
+            if(low=="--ack"){ opt.ack=true; continue; }
+            if(low=="--binary"){ opt.binary=true; continue; }
+            if(low=="--daemon"){ daemon=true; continue; }
+            if(low=="--direct"){ direct=true; continue; }
+            if(low=="--rate" || low=="--burst" || low=="--window" || low=="--threads" || low=="--verify-retries"
+               || low=="--retries" || low=="--channels"){
+                if(i+1>=argc){ std::cerr<<"Missing value for "<<tok<<"\n"; return 1; }
+                double& dst = (low=="--rate") ? opt.rate : (low=="--burst") ? opt.burst
+                            : (low=="--window") ? opt.window : (low=="--threads") ? threads
+                            : (low=="--retries") ? opt.connect_retries : (low=="--channels") ? channels
+                            : opt.verify_retries;
+                if(!parse_number(tok, argv[++i], dst)) return 1;
+                // --rate 외에는 개수라 정수만 받는다 (size_t 등으로 바꿀 때 넘치지 않게 상한도 둔다)
+                if(low!="--rate" && (dst!=std::floor(dst) || dst>1e9)){
+                    std::cerr << "Invalid value for " << tok << ": " << argv[i] << "\n";
+                    return 1;
+                }
+                continue;
+            }
+            if(low=="--socket" || low=="--script" || low=="--seq"){
+                if(i+1>=argc){ std::cerr<<"Missing value for "<<tok<<"\n"; return 1; }
+                (low=="--socket" ? sock_path : low=="--script" ? script : seq_text) = argv[++i];
+                continue;
+            }
+            if(low=="--stdin"){ script="-"; continue; }
+            if(low=="--stats"){ g_stats_out.summary=true; continue; }
+            if(low=="--diff"){ opt.diff=true; continue; }
+            if(low=="--verify"){ opt.verify=true; continue; }
+            if(low=="--cache"){
+                if(i+1>=argc){ std::cerr<<"Missing value for "<<tok<<"\n"; return 1; }
+                opt.cache = argv[++i];
+                continue;
+            }
+            if(low=="--stats-json" || low=="--stats-prom"){
+                if(i+1>=argc){ std::cerr<<"Missing value for "<<tok<<"\n"; return 1; }
+                (low=="--stats-json" ? g_stats_out.json : g_stats_out.prom) = argv[++i];
+                continue;
+            }
+            if(low=="--target" || low=="--targets"){
+                if(i+1>=argc){ std::cerr<<"Missing value for "<<tok<<"\n"; return 1; }
+                if(low=="--targets"){
+                    if(!load_targets(argv[++i], targets)) return 1;
+                    continue;
+                }
+                Target t;
+                if(!parse_target(argv[++i], t)){ std::cerr<<"Invalid target: "<<argv[i]<<"\n"; return 1; }
+                add_target(targets, std::move(t));
+                continue;
+            }
+            if(low=="-w" || low=="--watch"){ watch=true; continue; }
+            if(low=="--interval" || low=="--timeout" || low=="--cache-ttl" || low=="--verify-backoff"
+               || low=="--connect-timeout" || low=="--io-timeout" || low=="--retry-backoff" || low=="--tick"){
+                if(i+1>=argc){ std::cerr<<"Missing value for "<<tok<<"\n"; return 1; }
+                auto& dst = (low=="--interval") ? interval : (low=="--timeout") ? timeout
+                          : (low=="--cache-ttl") ? opt.cache_ttl : (low=="--verify-backoff") ? opt.verify_backoff
+                          : (low=="--connect-timeout") ? opt.connect_timeout
+                          : (low=="--io-timeout") ? opt.io_timeout : (low=="--tick") ? seq.tick : opt.retry_backoff;
+                if(!parse_duration(argv[++i], dst)){ std::cerr<<"Invalid value for "<<tok<<": "<<argv[i]<<"\n"; return 1; }
+                continue;
+            }
             if(low=="-on"|| low=="--on"){
                 if(have_val && val==false){ std::cerr<<"Conflicting options: -on and -off\n"; return 1; }
                 have_val=true; val=true; continue;
@@ -134,6 +2928,78 @@ int main(int argc, char** argv){
             chanSpecs.push_back(tok);
         }
 
+        if(channels>kMaxChannels){ std::cerr<<"--channels must be at most "<<kMaxChannels<<"\n"; return 1; }
+        opt.channels = static_cast<int>(channels);
+
+        if(g_stats_out.enabled()){
+            if(daemon){ std::cerr<<"--stats options cannot be used with --daemon\n"; return 1; }
+            opt.stats = &g_stats;
+        }
+
+        if(targets.size()==1){
+            opt.host = targets[0].host;
+            opt.port = targets[0].port;
+        }else if(targets.size()>1 && (daemon || watch || !script.empty() || !seq_text.empty())){
+            std::cerr<<"Multiple targets are only supported with -s/-g\n";
+            return 1;
+        }
+        if(targets.size()>1 && !opt.cache.empty()){
+            // 한 파일을 여러 컨트롤러가 나눠 쓰면 다른 대상의 스냅샷으로 diff 하게 된다
+            std::cerr<<"--cache cannot be used with multiple targets (the default path is per target)\n";
+            return 1;
+        }
+
+        if(daemon){
+            if(want_set || want_get || !chanSpecs.empty()){ std::cerr<<"--daemon takes no set/get arguments\n"; return 1; }
+            return run_daemon(opt, sock_path);
+        }
+
+        if(!seq_text.empty()){
+            if(want_set || want_get || have_val || watch || !script.empty() || !chanSpecs.empty()){
+                std::cerr<<"--seq cannot be combined with -s/-g/-on/-off/--watch/--script or channels\n";
+                return 1;
+            }
+            if(seq.tick.count()<=0){ std::cerr<<"--tick must be positive\n"; return 1; }
+            if(seq_text[0]=='@'){
+                std::ifstream file{seq_text.substr(1)};
+                if(!file){ std::cerr<<"Cannot open sequence: "<<seq_text.substr(1)<<"\n"; return 1; }
+                seq_text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            }
+            if(!parse_sequence(seq_text, seq, std::cerr)) return 1;
+            Session session{opt};
+            session.connect(std::cout);
+            int rc = expand_sequence(seq, session.channels(), std::cerr) ? session.sequence(seq, std::cout, std::cerr) : 1;
+            session.close();
+            return rc;
+        }
+
+        if(!script.empty()){
+            if(want_set || want_get || !chanSpecs.empty()){ std::cerr<<"--script/--stdin take no set/get arguments\n"; return 1; }
+            std::ifstream file;
+            if(script!="-"){
+                file.open(script);
+                if(!file){ std::cerr<<"Cannot open script: "<<script<<"\n"; return 1; }
+            }
+            opt.one_line = true;
+            Session session{opt};
+            session.connect(std::cout);
+            int rc = run_script(session, script=="-" ? std::cin : file, script=="-" ? "<stdin>" : script);
+            session.close();
+            return rc;
+        }
+
+        if(watch){
+            if(want_set || want_get || have_val){ std::cerr<<"--watch cannot be combined with -s/-g/-on/-off\n"; return 1; }
+            if(chanSpecs.empty()) chanSpecs.push_back("all");
+            ChannelRanges watched;
+            for(const auto& spec: chanSpecs){
+                if(!parse_channels_token(spec, watched)) return 1;
+            }
+            Session session{opt};
+            session.connect(std::cout);
+            return session.watch(watched, interval, std::cout);
+        }
+
         if (want_get && !want_set && have_val) {
             std::cerr << "Error: -on/-off cannot be used with -g/--get when -s/--set is absent\n";
             return 1;
@@ -143,61 +3009,45 @@ int main(int argc, char** argv){
         if(chanSpecs.empty()){ std::cerr<<"No channels provided. Use e.g. 1,2,3 or 7-12 or all\n"; return 1; }
         if(want_set && !have_val){ std::cerr<<"Missing value for set. Use -on or -off\n"; return 1; }
 
-        std::vector<int> channels;
+        Request req;
+        req.set = want_set; req.get = want_get; req.val = val;
         for(const auto& spec: chanSpecs){
-            if(!parse_channels_token(spec, channels)) return 1;
+            if(!parse_channels_token(spec, req.channels)) return 1;
         }
-        std::sort(channels.begin(), channels.end());
-        channels.erase(std::unique(channels.begin(), channels.end()), channels.end());
 
-        net::io_context ioc;
-        tcp::resolver resolver{ioc};
-        auto eps = resolver.resolve(host, port);
-        websocket::stream<tcp::socket> ws{ioc};
-        net::connect(ws.next_layer(), eps.begin(), eps.end());
-        ws.handshake(host, "/");
-        ws.text(true);
-        std::cout << "Connected to " << host << ":" << port << "\n";
-
-        constexpr auto kDelay = std::chrono::milliseconds(50);
-
-        if(want_set){
-            for(size_t idx=0; idx<channels.size(); ++idx){
-                int ch = channels[idx];
-                std::string payload = std::string("{\"cmd\":\"set\",\"ch\":")
-                                      + std::to_string(ch) + ",\"val\":" + (val?"true":"false") + "}";
-                ws.write(net::buffer(payload));
-                std::cout << "Sent: set ch="<<ch<<" val="<<(val?"on":"off")<<"\n";
-                if(idx+1<channels.size()) std::this_thread::sleep_for(kDelay);
-            }
+        if(targets.size()>1){
+            unsigned n = threads>=1 ? static_cast<unsigned>(threads)
+                                    : std::max(1u, std::min<unsigned>(targets.size(), std::thread::hardware_concurrency()));
+            return run_fleet(opt, targets, req, timeout, n);
         }
 
-        if(want_get){
-            ws.write(net::buffer(std::string(R"({"cmd":"get"})")));
-            beast::flat_buffer buf;
-            ws.read(buf);
-            std::string body = beast::buffers_to_string(buf.data());
-            auto pins = parse_pins_from_json(body);
-            if(pins.empty()){
-                std::cout << "Received (raw): " << body << "\n";
-                std::cerr << "Warning: 'pins' array not found.\n";
-            }else{
-                std::cout << "Status:\n";
-                int per_line=16, cnt=0;
-                for(int ch: channels){
-                    bool in = (0<=ch && ch<(int)pins.size());
-                    std::cout << ch << ":" << (in ? (pins[ch]?"on":"off") : "n/a")
-                              << ((++cnt%per_line)?"  ":"\n");
-                }
-                if(cnt%per_line) std::cout << "\n";
-            }
+        // 요청 줄에 담기지 않는 옵션(--verify/--diff/--binary/--channels, 계측)이 있으면 데몬을 거치지 않는다.
+        // 데몬은 자기 실행 옵션으로 처리하므로 그대로 넘기면 조용히 무시된다.
+        const bool per_request = opt.verify || opt.diff || opt.binary || opt.channels>0;
+        if(!direct && targets.empty() && !opt.stats && !per_request){
+            int rc = forward_to_daemon(sock_path, request_lines(req), timeout);
+            if(rc>=0) return rc;
         }
 
-        ws.close(websocket::close_code::normal);
-        return 0;
+        Session session{opt};
+        session.connect(std::cout);
+        int rc = session.run(req, std::cout, std::cerr);
+        session.close();
+        return rc;
 
+    }catch(const beast::system_error& e){
+        std::cerr << "Error: " << e.what() << "\n";
+        return exit_code_for(e.code());
     }catch(const std::exception& e){
         std::cerr << "Error: " << e.what() << "\n";
         return 1;
     }
 }
+
+#ifndef KULGAD_NO_MAIN   // kulgad_fuzz.cpp 가 이 파일을 include 할 때 정의
+int main(int argc, char** argv){
+    int rc = cli_main(argc, argv);
+    if(g_stats_out.enabled() && g_stats.attempted()) emit_stats();
+    return rc;
+}
+#endif
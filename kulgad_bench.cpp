@@ -0,0 +1,285 @@
+// ------------------------------------------------------------------------------------------------------
+// kulgad-bench: kulgad 프로토콜의 지연/처리량 측정 도구 (kulgad-mock 또는 실제 컨트롤러 대상).
+//  • 프로토콜 직접 측정: connect+handshake, get 왕복, set 지연(id/ack 1개씩), 지속 처리량
+//  • --cli 지정 시 kulgad-cli 실행 모드별 전체 소요 시간 (채널별/batch/ack/script/daemon)
+// ------------------------------------------------------------------------------------------------------
+// Build: g++ -std=c++17 -O2 kulgad_bench.cpp -o kulgad-bench -lboost_system -lpthread
+// Run  :
+//   ./kulgad-mock --quiet --delay 1ms --jitter 500us &
+//   ./kulgad-bench                                  (localhost:3001, 각 200회)
+//   ./kulgad-bench --iterations 1000 --window 16 --cli ./kulgad-cli
+//   ./kulgad-bench --binary                         (kulgad.bin.v1 subprotocol 로 같은 측정)
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+using bench_clock = std::chrono::steady_clock;
+
+extern char** environ;
+
+static double ms_since(bench_clock::time_point t0){
+    return std::chrono::duration<double, std::milli>(bench_clock::now()-t0).count();
+}
+
+// 표본 ms 목록 → min/p50/p90/p99/max 한 줄
+static void report(const std::string& name, std::vector<double> ms){
+    if(ms.empty()){ std::printf("%-34s %6s\n", name.c_str(), "-"); return; }
+    std::sort(ms.begin(), ms.end());
+    auto pct = [&](double p){ return ms[std::min(ms.size()-1, static_cast<size_t>(p*(ms.size()-1)+0.5))]; };
+    std::printf("%-34s %6zu %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+                name.c_str(), ms.size(), ms.front(), pct(0.5), pct(0.9), pct(0.99), ms.back());
+}
+
+static void report_rate(const std::string& name, size_t n, double total_ms){
+    std::printf("%-34s %6zu %9.3f ms total  %10.0f cmd/s\n", name.c_str(), n, total_ms, n/(total_ms/1000.0));
+}
+
+struct Target{ std::string host = "localhost", port = "3001"; };
+
+// 바이너리 프로토콜 (kulgad.cpp 의 kulgad.bin.v1 설명 참고)
+static constexpr const char* kBinaryProtocol = "kulgad.bin.v1";
+enum : unsigned char { kBinGet=0x01, kBinSet=0x02, kBinStatus=0x81, kBinAck=0x82 };
+
+// binary 를 요청했는데 서버가 거절하면 false (JSON 으로 연결된 상태)
+static bool open_ws(net::io_context& ioc, const Target& t, websocket::stream<tcp::socket>& ws, bool binary){
+    tcp::resolver resolver{ioc};
+    auto eps = resolver.resolve(t.host, t.port);
+    net::connect(ws.next_layer(), eps.begin(), eps.end());
+    ws.next_layer().set_option(tcp::no_delay(true));
+    if(binary){
+        ws.set_option(websocket::stream_base::decorator([](websocket::request_type& req){
+            req.set(beast::http::field::sec_websocket_protocol, kBinaryProtocol);
+        }));
+    }
+    websocket::response_type res;
+    ws.handshake(res, t.host, "/");
+    bool accepted = binary && res[beast::http::field::sec_websocket_protocol]==kBinaryProtocol;
+    ws.binary(accepted);
+    return accepted==binary;
+}
+
+// 응답 중 "ok"(ack) 또는 "pins"(상태) 프레임이 올 때까지 읽는다 (push 등은 무시)
+static void read_until(websocket::stream<tcp::socket>& ws, beast::flat_buffer& buf, bool binary, bool ack){
+    for(;;){
+        buf.consume(buf.size());
+        ws.read(buf);
+        std::string body = beast::buffers_to_string(buf.data());
+        if(binary ? (!body.empty() && static_cast<unsigned char>(body[0])==(ack ? kBinAck : kBinStatus))
+                  : body.find(ack ? "\"ok\"" : "\"pins\"")!=std::string::npos) return;
+    }
+}
+
+static std::string set_frame(int ch, bool val, long long id, bool binary){
+    if(binary){
+        std::string f{static_cast<char>(kBinSet), static_cast<char>((val ? 1 : 0) | (id>=0 ? 2 : 0))};
+        if(id>=0) for(int k=0;k<4;++k) f += static_cast<char>(id>>(8*k));
+        std::string mask(32, '\0');
+        mask[ch/8] = static_cast<char>(1 << (ch%8));
+        return f + mask;
+    }
+    std::string f = "{\"cmd\":\"set\",\"ch\":" + std::to_string(ch) + ",\"val\":" + (val?"true":"false");
+    if(id>=0) f += ",\"id\":" + std::to_string(id);
+    return f + "}";
+}
+
+static void bench_protocol(const Target& t, int iterations, int window, bool binary){
+    net::io_context ioc;
+    const std::string get = binary ? std::string(1, static_cast<char>(kBinGet)) : std::string(R"({"cmd":"get"})");
+
+    std::vector<double> ms;
+    for(int i=0;i<iterations;++i){
+        websocket::stream<tcp::socket> ws{ioc};
+        auto t0 = bench_clock::now();
+        open_ws(ioc, t, ws, binary);
+        ms.push_back(ms_since(t0));
+        ws.close(websocket::close_code::normal);
+    }
+    report("connect+handshake", ms);
+
+    websocket::stream<tcp::socket> ws{ioc};
+    if(!open_ws(ioc, t, ws, binary)) throw std::runtime_error("server did not accept the binary subprotocol");
+    beast::flat_buffer buf;
+
+    ms.clear();
+    for(int i=0;i<iterations;++i){
+        auto t0 = bench_clock::now();
+        ws.write(net::buffer(get));
+        read_until(ws, buf, binary, false);
+        ms.push_back(ms_since(t0));
+    }
+    report("get round trip", ms);
+    std::printf("%-34s %6zu bytes\n", "status frame size", buf.size());
+
+    ms.clear();
+    long long id = 1;
+    for(int i=0;i<iterations;++i){
+        auto t0 = bench_clock::now();
+        ws.write(net::buffer(set_frame(i%256, i%2==0, id++, binary)));
+        read_until(ws, buf, binary, true);
+        ms.push_back(ms_since(t0));
+    }
+    report("set latency (ack)", ms);
+
+    // 응답 없는 set 을 연속으로 보내고 get 하나로 처리 완료를 확인
+    auto t0 = bench_clock::now();
+    for(int i=0;i<iterations;++i) ws.write(net::buffer(set_frame(i%256, true, -1, binary)));
+    ws.write(net::buffer(get));
+    read_until(ws, buf, binary, false);
+    report_rate("set throughput (fire+get barrier)", iterations, ms_since(t0));
+
+    // ack 대기 프레임을 최대 window 개 유지
+    t0 = bench_clock::now();
+    int sent=0, acked=0;
+    while(acked<iterations){
+        while(sent<iterations && sent-acked<window) ws.write(net::buffer(set_frame(sent++%256, false, id++, binary)));
+        read_until(ws, buf, binary, true);
+        ++acked;
+    }
+    report_rate("set throughput (ack window " + std::to_string(window) + ")", iterations, ms_since(t0));
+
+    ws.close(websocket::close_code::normal);
+}
+
+static pid_t spawn(const std::vector<std::string>& args, bool quiet){
+    std::vector<char*> argv;
+    for(auto& a: args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    if(quiet){
+        posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&fa, 2, "/dev/null", O_WRONLY, 0);
+    }
+    pid_t pid = -1;
+    if(posix_spawn(&pid, argv[0], &fa, nullptr, argv.data(), environ)!=0) pid = -1;
+    posix_spawn_file_actions_destroy(&fa);
+    return pid;
+}
+
+// CLI 한 번 실행의 벽시계 시간(ms). 실패 시 음수.
+static double time_cli(const std::vector<std::string>& args){
+    auto t0 = bench_clock::now();
+    pid_t pid = spawn(args, true);
+    if(pid<0) return -1;
+    int status=0;
+    waitpid(pid, &status, 0);
+    double ms = ms_since(t0);
+    return (WIFEXITED(status) && WEXITSTATUS(status)==0) ? ms : -1;
+}
+
+static void bench_cli(const std::string& cli, const Target& t, int runs){
+    const std::string target = t.host + ":" + t.port;
+    const std::string script = "/tmp/kulgad-bench-" + std::to_string(::getpid()) + ".txt";
+    const std::string sock   = "/tmp/kulgad-bench-" + std::to_string(::getpid()) + ".sock";
+    {
+        std::ofstream f{script};
+        for(int i=0;i<4;++i) f << "set 0-127 on\nget all\n";
+    }
+
+    struct Mode{ std::string name; std::vector<std::string> args; };
+    std::vector<Mode> modes = {
+        {"cli per-channel 16ch @20/s", {"-s", "-on", "0-15", "--no-batch"}},
+        {"cli per-channel 256ch unpaced", {"-s", "-on", "all", "--no-batch", "--rate", "0"}},
+        {"cli per-channel 256ch ack w16", {"-s", "-on", "all", "--no-batch", "--rate", "0", "--ack", "--window", "16"}},
+        {"cli batch set all", {"-s", "-on", "all"}},
+        {"cli get all", {"-g", "all"}},
+        {"cli script (8 cmds)", {"--script", script}},
+    };
+    for(auto& m: modes){
+        std::vector<std::string> args{cli};
+        args.insert(args.end(), m.args.begin(), m.args.end());
+        args.push_back("--target");
+        args.push_back(target);
+        std::vector<double> ms;
+        for(int i=0;i<runs;++i){
+            double v = time_cli(args);
+            if(v<0){ std::cerr << m.name << ": kulgad-cli failed\n"; break; }
+            ms.push_back(v);
+        }
+        report(m.name, ms);
+    }
+
+    // 데몬 경유: 데몬을 띄우고 소켓으로 전달되는 get 시간
+    pid_t daemon = spawn({cli, "--daemon", "--socket", sock, "--target", target}, true);
+    if(daemon>0){
+        std::vector<double> ms;
+        for(int i=0;i<50 && ::access(sock.c_str(), F_OK)!=0; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        for(int i=0;i<runs;++i){
+            double v = time_cli({cli, "-g", "all", "--socket", sock});
+            if(v<0){ std::cerr << "daemon forward: kulgad-cli failed\n"; break; }
+            ms.push_back(v);
+        }
+        report("cli get all via daemon", ms);
+        ::kill(daemon, SIGTERM);
+        waitpid(daemon, nullptr, 0);
+    }
+    std::remove(script.c_str());
+}
+
+static void usage(){
+    std::cerr
+      << "Usage:\n"
+      << "  kulgad-bench [options]\n"
+      << "Options:\n"
+      << "  --target H:P      : 측정 대상 (기본 localhost:3001)\n"
+      << "  --iterations N    : 프로토콜 측정 반복 횟수 (기본 200)\n"
+      << "  --window W        : ack 처리량 측정 시 대기 프레임 수 (기본 16)\n"
+      << "  --cli PATH        : kulgad-cli 실행 모드별 시간도 측정\n"
+      << "  --runs N          : --cli 모드별 실행 횟수 (기본 10)\n"
+      << "  --binary          : 프로토콜 측정을 바이너리 subprotocol 로\n";
+}
+
+int main(int argc, char** argv){
+    try{
+        Target t;
+        int iterations = 200, window = 16, runs = 10;
+        std::string cli;
+        bool binary = false;
+        for(int i=1;i<argc;++i){
+            std::string tok = argv[i];
+            if(tok=="--binary"){ binary = true; continue; }
+            if(i+1>=argc){ usage(); return 1; }
+            std::string v = argv[++i];
+            if(tok=="--target"){
+                auto colon = v.rfind(':');
+                t.host = v.substr(0, colon);
+                if(colon!=std::string::npos) t.port = v.substr(colon+1);
+            }
+            else if(tok=="--iterations") iterations = std::max(1, std::atoi(v.c_str()));
+            else if(tok=="--window")     window = std::max(1, std::atoi(v.c_str()));
+            else if(tok=="--runs")       runs = std::max(1, std::atoi(v.c_str()));
+            else if(tok=="--cli")        cli = v;
+            else{ usage(); return 1; }
+        }
+
+        std::printf("%-34s %6s %9s %9s %9s %9s %9s  (ms)\n", "benchmark", "n", "min", "p50", "p90", "p99", "max");
+        bench_protocol(t, iterations, window, binary);
+        if(!cli.empty()) bench_cli(cli, t, runs);
+        return 0;
+
+    }catch(const std::exception& e){
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,223 @@
+// ------------------------------------------------------------------------------------------------------
+// kulgad-fuzz: pins 디코더(decode_pins) 자체 검사 도구.
+//  • 무작위로 만든 정상 프레임과 그 변형(바이트 치환/삽입/삭제/절단)을 decode_pins 의
+//    scalar / SSE2 / AVX2 분류 경로에 모두 넣어 결과(성공 여부, size, on 비트, bank)가 같은지,
+//  • 그리고 decode_pins 가 받아들인 프레임은 이전 파서(parse_pins_from_json)도 같은 핀 상태로
+//    읽는지 확인한다 ("pins" 가 한 번만 나오는 프레임). 정상 프레임은 반드시 받아들여야 한다.
+//  • 입력은 길이에 딱 맞는 힙 버퍼로 복사해 넘기므로 -fsanitize=address 로 빌드하면 과독도 잡힌다.
+// ------------------------------------------------------------------------------------------------------
+// Build: g++ -std=c++17 -O2 -mavx2 kulgad_fuzz.cpp -o kulgad-fuzz -lboost_system -lpthread
+//        (-mavx2 를 빼면 AVX2 경로는 건너뛴다)
+// Run  :
+//   ./kulgad-fuzz                                   (200000회, 시드는 시각)
+//   ./kulgad-fuzz --iterations 1000000 --seed 42
+
+// kulgad.cpp 를 그대로 가져와 같은 디코더를 검사한다 (main 은 빼고, 쓰지 않는 CLI 함수 경고는 끈다)
+#define KULGAD_NO_MAIN
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "kulgad.cpp"
+#pragma GCC diagnostic pop
+
+namespace {
+
+struct Path{ const char* name; bool (*decode)(const char*, size_t, Pins&); };
+
+const Path kPaths[] = {
+    {"scalar", decode_pins<classify32_scalar>},
+#if defined(__SSE2__)
+    {"sse2",   decode_pins<classify32_sse2>},
+#endif
+#if defined(__AVX2__)
+    {"avx2",   decode_pins<classify32_avx2>},
+#endif
+};
+
+bool same(const Pins& a, const Pins& b, bool bank){
+    return a.size==b.size && a.on==b.on && (!bank || a.bank==b.bank);
+}
+
+std::string show(const std::string& frame){
+    std::string out;
+    for(char c: frame){
+        unsigned char u = static_cast<unsigned char>(c);
+        if(u>=0x20 && u<0x7f) out += c;
+        else{ char hex[8]; std::snprintf(hex, sizeof hex, "\\x%02x", u); out += hex; }
+    }
+    return out;
+}
+
+class Generator{
+public:
+    explicit Generator(std::uint64_t seed): rng_(seed) {}
+
+    // 구조가 올바른 상태 프레임. 키 순서, 공백, 다른 키(중첩 값, ']' 나 't'/'f' 가 든 문자열) 를 섞는다.
+    std::string frame(){
+        std::vector<std::string> members;
+        std::string pins = "\"pins\"" + ws() + ":" + ws() + "[" + ws();
+        int n = 1 + pick(300);
+        for(int i=0;i<n;++i){
+            if(i) pins += ws() + "," + ws();
+            pins += pick(2) ? "true" : "false";
+        }
+        pins += ws() + "]";
+        members.push_back(pins);
+        if(pick(2)) members.push_back("\"bank\"" + ws() + ":" + ws() + std::to_string(pick(256)));
+        for(int k=pick(4); k>0; --k) members.push_back(quote(word()) + ws() + ":" + ws() + value(0));
+        std::shuffle(members.begin(), members.end(), rng_);
+        std::string out = ws() + "{" + ws();
+        for(size_t i=0;i<members.size();++i){
+            if(i) out += ws() + "," + ws();
+            out += members[i];
+        }
+        return out + ws() + "}" + ws();
+    }
+
+    // 바이트 치환/삽입/삭제/절단을 1~4번
+    std::string mutate(std::string s){
+        static const char alphabet[] = "tf][{},:\" \\ntruefalse0123456789-";
+        for(int k=1+pick(4); k>0 && !s.empty(); --k){
+            size_t at = pick(static_cast<int>(s.size()));
+            switch(pick(5)){
+            case 0: s[at] = alphabet[pick(sizeof alphabet - 1)]; break;
+            case 1: s.insert(at, 1, alphabet[pick(sizeof alphabet - 1)]); break;
+            case 2: s.erase(at, 1 + pick(4)); break;
+            case 3: s.resize(at); break;
+            default: s[at] = static_cast<char>(pick(256)); break;
+            }
+        }
+        return s;
+    }
+
+private:
+    int pick(int n){ return std::uniform_int_distribution<int>(0, n-1)(rng_); }
+
+    std::string ws(){
+        static const char* const spaces[] = {"", "", "", " ", "\n", "\t ", "  \r\n"};
+        return spaces[pick(7)];
+    }
+    std::string word(){
+        static const char* const words[] = {"ts", "id", "ok", "name", "meta", "pin", "pinsx", "t", "f"};
+        return words[pick(9)];
+    }
+    std::string quote(const std::string& s){ return "\"" + s + "\""; }
+
+    std::string value(int depth){
+        switch(depth<3 ? pick(6) : pick(3)){
+        case 0: return std::to_string(pick(100000)) + (pick(2) ? ".5" : "");
+        case 1: return pick(2) ? "true" : pick(2) ? "false" : "null";
+        case 2: return quote(pick(2) ? "a]b t f \\\" x" : "[true,false]");
+        case 3: {
+            std::string a = "[" + ws();
+            for(int k=pick(4); k>0; --k) a += value(depth+1) + (k>1 ? "," + ws() : ws());
+            return a + "]";
+        }
+        default: {
+            std::string o = "{" + ws();
+            for(int k=pick(3); k>0; --k) o += quote(word()) + ":" + value(depth+1) + (k>1 ? "," : "");
+            return o + ws() + "}";
+        }
+        }
+    }
+
+    std::mt19937_64 rng_;
+};
+
+// 한 프레임 검사. 실패 사유를 why 에 남기고 false.
+bool check(const std::string& frame, bool valid, std::string& why){
+    std::vector<char> exact(frame.begin(), frame.end());
+    const char* data = exact.empty() ? nullptr : exact.data();
+
+    Pins first;
+    bool first_ok = kPaths[0].decode(data, exact.size(), first);
+    for(const auto& path: kPaths){
+        Pins p;
+        bool ok = path.decode(data, exact.size(), p);
+        if(ok!=first_ok || (ok && !same(p, first, true))){
+            why = std::string(path.name) + " disagrees with " + kPaths[0].name;
+            return false;
+        }
+    }
+    if(valid && !first_ok){ why = "valid frame rejected"; return false; }
+    // 이전 파서는 처음 나온 "pins" 문자열을 쓰므로, 변형으로 중첩 값 안에 "pins" 키가 생긴 프레임은 비교하지 않는다
+    const size_t key = frame.find("\"pins\"");
+    if(first_ok && frame.find("\"pins\"", key+1)==std::string::npos){
+        Pins ref;
+        if(!parse_pins_from_json(frame, ref) || !same(ref, first, false)){
+            why = "accepted frame differs from parse_pins_from_json";
+            return false;
+        }
+    }
+    return true;
+}
+
+void print_usage(){
+    std::cerr
+      << "Usage:\n"
+      << "  kulgad-fuzz [options]\n"
+      << "Options:\n"
+      << "  --iterations N    : 생성할 정상 프레임 수 (각각 변형 4개를 함께 검사, 기본 200000)\n"
+      << "  --seed S          : 난수 시드 (기본 현재 시각, 실패 재현용으로 출력됨)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    long long iterations = 200000;
+    std::uint64_t seed = static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    for(int i=1;i<argc;++i){
+        std::string tok = argv[i];
+        if((tok=="--iterations" || tok=="--seed") && i+1<argc){
+            char* end = nullptr;
+            unsigned long long v = std::strtoull(argv[++i], &end, 10);
+            if(*end){ std::cerr<<"Invalid value for "<<tok<<": "<<argv[i]<<"\n"; return 1; }
+            if(tok=="--iterations") iterations = static_cast<long long>(v);
+            else seed = v;
+        }else{
+            print_usage();
+            return 1;
+        }
+    }
+
+    std::cout << "seed " << seed << ", paths:";
+    for(const auto& path: kPaths) std::cout << " " << path.name;
+    std::cout << "\n";
+
+    Generator gen{seed};
+    long long frames = 0, accepted = 0;
+    std::string why;
+    for(long long i=0;i<iterations;++i){
+        std::string frame = gen.frame();
+        ++frames;
+        if(!check(frame, true, why)){
+            std::cerr << "FAIL (" << why << "): " << show(frame) << "\n";
+            return 1;
+        }
+        ++accepted;
+        for(int k=0;k<4;++k){
+            std::string bad = gen.mutate(frame);
+            ++frames;
+            if(!check(bad, false, why)){
+                std::cerr << "FAIL (" << why << "): " << show(bad) << "\n";
+                return 1;
+            }
+        }
+    }
+
+    // 경계: 빈 입력, 빈 배열, 32바이트 경계에 걸친 닫는 괄호
+    for(const char* edge: {"", "{}", "{\"pins\":[]}", "{\"pins\":[true]}", "{\"pins\":[true,false,true,false,true,false]}  "}){
+        ++frames;
+        if(!check(edge, false, why)){
+            std::cerr << "FAIL (" << why << "): " << show(edge) << "\n";
+            return 1;
+        }
+    }
+    // 빈 pins 배열은 이전 파서와 같이 pins 없음
+    Pins empty;
+    if(decode_pins("{\"pins\":[]}", 11, empty)){
+        std::cerr << "FAIL (empty pins array accepted)\n";
+        return 1;
+    }
+    std::cout << frames << " frames checked (" << accepted << " generated valid), all paths agree\n";
+    return 0;
+}
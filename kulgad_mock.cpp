@@ -0,0 +1,458 @@
+// ------------------------------------------------------------------------------------------------------
+// kulgad-mock: 실제 하드웨어 없이 kulgad-cli / kulgad-bench 를 돌리기 위한 컨트롤러 대역 서버.
+//  • --channels 개(기본 256) 핀 상태를 메모리에 보관하고 {"cmd":"set"} / {"cmd":"get"} 프로토콜을 구현한다.
+//  • set: "ch" 단일, batch("chs" / "ranges" / "mask"), "id" 가 있으면 {"ok":...,"id":N} 응답.
+//  • get: {"pins":[true,false,...]}
+//  • 256채널을 넘으면 256개씩 bank 로 나누고 프레임의 "bank":B 로 고른다 (없으면 0, 응답에도 "bank":B).
+//    핸드셰이크 응답의 X-Kulgad-Caps 에 channels=N 을 광고한다.
+//  • 클라이언트가 Sec-WebSocket-Protocol: kulgad.bin.v1 을 제안하면 바이너리 프레임으로 응답 (kulgad.cpp 참고).
+//  • 명령마다 --delay + [0, --jitter] 만큼 늦게 처리한다 (연결별로 순서 유지).
+// ------------------------------------------------------------------------------------------------------
+// Build: g++ -std=c++17 -O2 kulgad_mock.cpp -o kulgad-mock -lboost_system -lpthread
+// Run  :
+//   ./kulgad-mock                                  (127.0.0.1:3001, 지연 없음)
+//   ./kulgad-mock --port 3002 --delay 2ms --jitter 1ms
+//   ./kulgad-mock --no-batch                       (batch 미지원 컨트롤러 흉내)
+//   ./kulgad-mock --no-binary                      (바이너리 프로토콜 미지원, 항상 JSON)
+//   ./kulgad-mock --push                           (핀이 바뀌면 다른 연결에 상태 push)
+//   ./kulgad-mock --port 3002 --drop 0.1           (set 의 10% 를 적용하지 않는 불량 컨트롤러 흉내)
+//   ./kulgad-mock --channels 1024                  (bank 4개짜리 컨트롤러 흉내)
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+static constexpr int kChannels = 256;       // bank 하나의 채널 수
+static constexpr int kMaxChannels = 256*kChannels;
+static constexpr const char* kBinaryProtocol = "kulgad.bin.v1";
+enum : unsigned char { kBinGet=0x01, kBinSet=0x02, kBinStatus=0x81, kBinAck=0x82 };
+enum : unsigned char { kBinFlagVal=1, kBinFlagId=2, kBinFlagBank=4 };
+
+struct MockOptions{
+    std::string address = "127.0.0.1";
+    unsigned short port = 3001;
+    std::chrono::steady_clock::duration delay{}, jitter{};
+    bool batch = true;
+    bool binary = true;
+    bool push = false;
+    bool quiet = false;
+    double drop = 0;            // 채널별 set 을 (ok 응답은 하면서) 무시할 확률
+    int channels = kChannels;
+};
+
+class MockSession;
+
+// 모든 연결이 공유하는 컨트롤러 상태 (단일 스레드 io_context 에서만 접근)
+struct Controller{
+    MockOptions opt;
+    std::vector<bool> pins;     // opt.channels 개
+    std::vector<std::weak_ptr<MockSession>> sessions;
+    std::mt19937_64 rng{std::random_device{}()};
+    unsigned long long commands = 0;
+
+    int banks() const { return (opt.channels + kChannels - 1)/kChannels; }
+    int bank_size(int bank) const { return std::min(kChannels, opt.channels - bank*kChannels); }
+    bool pin(int bank, int ch) const { return ch<bank_size(bank) && pins[bank*kChannels + ch]; }
+
+    std::string status_json(int bank) const {
+        std::string r = bank ? "{\"bank\":" + std::to_string(bank) + ",\"pins\":[" : "{\"pins\":[";
+        for(int i=0;i<bank_size(bank);++i){
+            if(i) r += ',';
+            r += pin(bank, i) ? "true" : "false";
+        }
+        return r + "]}";
+    }
+
+    // [0x81][size u16 LE][bitmap 32B][bank u16 LE (bank>0)]
+    std::string status_binary(int bank) const {
+        const int size = bank_size(bank);
+        std::string r{static_cast<char>(kBinStatus), static_cast<char>(size & 0xff), static_cast<char>(size>>8)};
+        for(int i=0;i<kChannels/8;++i){
+            unsigned char b=0;
+            for(int k=0;k<8;++k) b |= pin(bank, i*8+k) << k;
+            r += static_cast<char>(b);
+        }
+        if(bank){
+            r += static_cast<char>(bank & 0xff);
+            r += static_cast<char>(bank>>8);
+        }
+        return r;
+    }
+
+    std::chrono::steady_clock::duration next_delay(){
+        auto d = opt.delay;
+        if(opt.jitter.count()>0)
+            d += std::chrono::steady_clock::duration(std::uniform_int_distribution<long long>(0, opt.jitter.count())(rng));
+        return d;
+    }
+
+    void broadcast(const MockSession* except, int bank);
+};
+
+// ── 최소 JSON 필드 추출 (프로토콜 프레임은 평평한 객체라 이 정도로 충분) ─────────────
+static bool find_field(const std::string& js, const char* key, size_t& pos){
+    std::string k = std::string("\"") + key + "\"";
+    auto p = js.find(k);
+    if(p==std::string::npos) return false;
+    p = js.find(':', p+k.size());
+    if(p==std::string::npos) return false;
+    pos = js.find_first_not_of(" \t\r\n", p+1);
+    return pos!=std::string::npos;
+}
+
+static bool read_int(const std::string& js, size_t& pos, long long& v){
+    size_t used=0;
+    try{ v = std::stoll(js.substr(pos, 20), &used); }catch(const std::exception&){ return false; }
+    pos += used;
+    return true;
+}
+
+// set 프레임을 (bank 안) 채널 목록으로 풀어낸다. size 는 bank 의 채널 수. 실패 시 err 에 사유.
+static bool decode_set(const std::string& js, int size, std::vector<int>& chs, bool& val, std::string& err){
+    auto valid_channel = [size](long long ch){ return 0<=ch && ch<size; };
+    size_t p;
+    if(!find_field(js, "val", p)){ err = "missing val"; return false; }
+    if(js.compare(p, 4, "true")==0) val = true;
+    else if(js.compare(p, 5, "false")==0) val = false;
+    else{ err = "bad val"; return false; }
+
+    long long a, b;
+    if(find_field(js, "ch", p)){
+        if(!read_int(js, p, a) || !valid_channel(a)){ err = "bad ch"; return false; }
+        chs.push_back(static_cast<int>(a));
+    }else if(find_field(js, "chs", p) && js[p]=='['){
+        for(++p;;){
+            p = js.find_first_not_of(" ,", p);
+            if(p==std::string::npos){ err = "bad chs"; return false; }
+            if(js[p]==']') break;
+            if(!read_int(js, p, a) || !valid_channel(a)){ err = "bad chs"; return false; }
+            chs.push_back(static_cast<int>(a));
+        }
+    }else if(find_field(js, "ranges", p) && js[p]=='['){
+        for(++p;;){
+            p = js.find_first_not_of(" ,", p);
+            if(p==std::string::npos){ err = "bad ranges"; return false; }
+            if(js[p]==']') break;
+            if(js[p]!='['){ err = "bad ranges"; return false; }
+            ++p;
+            if(!read_int(js, p, a)){ err = "bad ranges"; return false; }
+            p = js.find_first_not_of(" ,", p);
+            if(p==std::string::npos || !read_int(js, p, b)){ err = "bad ranges"; return false; }
+            if(a>b) std::swap(a, b);
+            if(!valid_channel(a) || !valid_channel(b)){ err = "bad ranges"; return false; }
+            for(long long ch=a; ch<=b; ++ch) chs.push_back(static_cast<int>(ch));
+            p = js.find(']', p);
+            if(p==std::string::npos){ err = "bad ranges"; return false; }
+            ++p;
+        }
+    }else if(find_field(js, "mask", p) && js[p]=='"'){
+        if(p+1+kChannels/4>js.size()){ err = "bad mask"; return false; }
+        for(int i=0;i<kChannels/8;++i){
+            unsigned byte=0;
+            for(int k=0;k<2;++k){
+                char c = js[p+1+2*i+k];
+                int v = (c>='0'&&c<='9') ? c-'0' : (c>='a'&&c<='f') ? c-'a'+10 : (c>='A'&&c<='F') ? c-'A'+10 : -1;
+                if(v<0){ err = "bad mask"; return false; }
+                byte = byte*16 + v;
+            }
+            for(int k=0;k<8;++k) if((byte>>k)&1) chs.push_back(i*8+k);
+        }
+        if(!chs.empty() && !valid_channel(chs.back())){ err = "bad mask"; return false; }
+    }else{
+        err = "missing channels";
+        return false;
+    }
+    return true;
+}
+
+class MockSession : public std::enable_shared_from_this<MockSession>{
+public:
+    MockSession(tcp::socket sock, Controller& ctl)
+      : ws_(std::move(sock)), ctl_(ctl), timer_(ws_.get_executor()) {}
+
+    // 업그레이드 요청을 먼저 읽어 subprotocol 제안을 보고 응답 헤더를 정한다
+    void run(){
+        beast::http::async_read(ws_.next_layer(), buf_, upgrade_, [self=shared_from_this()](beast::error_code ec, std::size_t){
+            if(ec) return;
+            self->accept();
+        });
+    }
+
+    void send(std::string msg, bool binary = false){
+        outq_.push_back({std::move(msg), binary});
+        if(outq_.size()==1) write_next();
+    }
+
+    void send_status(int bank){
+        if(binary_) send(ctl_.status_binary(bank), true);
+        else send(ctl_.status_json(bank));
+    }
+
+private:
+    void accept(){
+        const std::string caps = (ctl_.opt.batch ? "batch, channels=" : "channels=") + std::to_string(ctl_.opt.channels);
+        binary_ = ctl_.opt.binary && offered(upgrade_[beast::http::field::sec_websocket_protocol]);
+        ws_.set_option(websocket::stream_base::decorator([caps, binary=binary_](websocket::response_type& res){
+            res.set("X-Kulgad-Caps", caps);
+            if(binary) res.set(beast::http::field::sec_websocket_protocol, kBinaryProtocol);
+        }));
+        ws_.async_accept(upgrade_, [self=shared_from_this()](beast::error_code ec){
+            if(ec) return;
+            self->ctl_.sessions.push_back(self);
+            self->read();
+        });
+    }
+
+    static bool offered(beast::string_view protocols){
+        while(!protocols.empty()){
+            auto comma = protocols.find(',');
+            auto tok = protocols.substr(0, comma);
+            while(!tok.empty() && tok.front()==' ') tok.remove_prefix(1);
+            while(!tok.empty() && tok.back()==' ')  tok.remove_suffix(1);
+            if(tok==kBinaryProtocol) return true;
+            if(comma==beast::string_view::npos) break;
+            protocols.remove_prefix(comma+1);
+        }
+        return false;
+    }
+
+    void read(){
+        buf_.consume(buf_.size());
+        ws_.async_read(buf_, [self=shared_from_this()](beast::error_code ec, std::size_t){
+            if(ec) return;
+            self->timer_.expires_after(self->ctl_.next_delay());
+            self->timer_.async_wait([self](beast::error_code ec){
+                if(ec) return;
+                if(self->ws_.got_binary()) self->handle_binary(beast::buffers_to_string(self->buf_.data()));
+                else self->handle(beast::buffers_to_string(self->buf_.data()));
+                self->read();
+            });
+        });
+    }
+
+    void handle(const std::string& msg){
+        ++ctl_.commands;
+        if(!ctl_.opt.quiet) std::cout << "recv " << msg.substr(0, 160) << "\n";
+
+        size_t p;
+        long long id = -1;
+        if(find_field(msg, "id", p)) read_int(msg, p, id);
+        long long bank = 0;
+        if(find_field(msg, "bank", p) && (!read_int(msg, p, bank) || bank<0 || bank>=ctl_.banks())){
+            send("{\"ok\":false" + (id>=0 ? ",\"id\":" + std::to_string(id) : std::string()) + ",\"err\":\"bad bank\"}");
+            return;
+        }
+
+        if(msg.find("\"get\"")!=std::string::npos){
+            send(ctl_.status_json(static_cast<int>(bank)));
+            return;
+        }
+        if(msg.find("\"set\"")==std::string::npos){
+            if(id>=0) send("{\"ok\":false,\"id\":" + std::to_string(id) + ",\"err\":\"unknown cmd\"}");
+            return;
+        }
+
+        std::vector<int> chs;
+        bool val = false;
+        std::string err;
+        if(!decode_set(msg, ctl_.bank_size(static_cast<int>(bank)), chs, val, err)){
+            if(id>=0) send("{\"ok\":false,\"id\":" + std::to_string(id) + ",\"err\":\"" + err + "\"}");
+            return;
+        }
+        apply(static_cast<int>(bank), chs, val);
+        if(id>=0) send("{\"ok\":true,\"id\":" + std::to_string(id) + "}");
+    }
+
+    // get: [0x01][bank u16 LE]?  set: [0x02][flags][id u32 LE (flags&2)][bank u16 LE (flags&4)][mask 32B]
+    // 없는 bank 의 get 은 무시, set 은 ok=0
+    void handle_binary(const std::string& msg){
+        ++ctl_.commands;
+        if(!ctl_.opt.quiet) std::cout << "recv binary " << msg.size() << " bytes op=" << int(static_cast<unsigned char>(msg[0])) << "\n";
+        auto u16 = [&](size_t at){ return static_cast<unsigned char>(msg[at]) | static_cast<unsigned char>(msg[at+1])<<8; };
+        if((msg.size()==1 || msg.size()==3) && static_cast<unsigned char>(msg[0])==kBinGet){
+            int bank = msg.size()==3 ? u16(1) : 0;
+            if(bank<ctl_.banks()) send(ctl_.status_binary(bank), true);
+            return;
+        }
+        if(msg.size()<2 || static_cast<unsigned char>(msg[0])!=kBinSet) return;
+        const unsigned flags = static_cast<unsigned char>(msg[1]);
+        size_t at = 2;
+        long long id = -1;
+        if(flags & kBinFlagId){
+            if(msg.size()<6) return;
+            id = 0;
+            for(int k=3;k>=0;--k) id = id<<8 | static_cast<unsigned char>(msg[2+k]);
+            at = 6;
+        }
+        int bank = 0;
+        if(flags & kBinFlagBank){
+            if(msg.size()<at+2) return;
+            bank = u16(at);
+            at += 2;
+        }
+        std::vector<int> chs;
+        bool ok = msg.size()==at+kChannels/8 && bank<ctl_.banks();
+        if(ok){
+            for(int i=0;i<kChannels/8;++i)
+                for(int k=0;k<8;++k) if((static_cast<unsigned char>(msg[at+i])>>k)&1) chs.push_back(i*8+k);
+            ok = chs.empty() || chs.back()<ctl_.bank_size(bank);
+        }
+        if(ok) apply(bank, chs, flags & kBinFlagVal);
+        if(id>=0){
+            std::string ack{static_cast<char>(kBinAck), static_cast<char>(ok)};
+            for(int k=0;k<4;++k) ack += static_cast<char>(id>>(8*k));
+            send(ack, true);
+        }
+    }
+
+    void apply(int bank, const std::vector<int>& chs, bool val){
+        bool changed = false;
+        std::bernoulli_distribution dropped{ctl_.opt.drop};
+        for(int ch: chs){
+            if(ctl_.opt.drop>0 && dropped(ctl_.rng)) continue;
+            auto pin = ctl_.pins[bank*kChannels + ch];
+            changed |= (pin!=val);
+            pin = val;
+        }
+        if(changed && ctl_.opt.push) ctl_.broadcast(this, bank);
+    }
+
+    void write_next(){
+        ws_.binary(outq_.front().binary);
+        ws_.async_write(net::buffer(outq_.front().body), [self=shared_from_this()](beast::error_code ec, std::size_t){
+            if(ec) return;
+            self->outq_.pop_front();
+            if(!self->outq_.empty()) self->write_next();
+        });
+    }
+
+    websocket::stream<tcp::socket> ws_;
+    Controller& ctl_;
+    net::steady_timer timer_;
+    beast::flat_buffer buf_;
+    beast::http::request<beast::http::empty_body> upgrade_;
+    bool binary_ = false;
+    struct Out{ std::string body; bool binary; };
+    std::deque<Out> outq_;
+};
+
+void Controller::broadcast(const MockSession* except, int bank){
+    auto it = sessions.begin();
+    while(it!=sessions.end()){
+        auto s = it->lock();
+        if(!s){ it = sessions.erase(it); continue; }
+        if(s.get()!=except) s->send_status(bank);
+        ++it;
+    }
+}
+
+static void accept_loop(tcp::acceptor& acceptor, Controller& ctl){
+    acceptor.async_accept([&acceptor, &ctl](beast::error_code ec, tcp::socket sock){
+        if(ec) return;
+        sock.set_option(tcp::no_delay(true));
+        std::make_shared<MockSession>(std::move(sock), ctl)->run();
+        accept_loop(acceptor, ctl);
+    });
+}
+
+// "200ms", "1.5s", "500us", 단위 생략 시 ms
+static bool parse_duration(const std::string& text, std::chrono::steady_clock::duration& out){
+    size_t used=0;
+    double v=0;
+    try{ v = std::stod(text, &used); }catch(const std::exception&){ return false; }
+    std::string unit = text.substr(used);
+    double scale;
+    if(unit.empty() || unit=="ms") scale = 1e-3;
+    else if(unit=="s")             scale = 1;
+    else if(unit=="us")            scale = 1e-6;
+    else return false;
+    if(v<0) return false;
+    out = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(v*scale));
+    return true;
+}
+
+static void usage(){
+    std::cerr
+      << "Usage:\n"
+      << "  kulgad-mock [options]\n"
+      << "Options:\n"
+      << "  --address A       : bind 주소 (기본 127.0.0.1)\n"
+      << "  --port N          : 포트 (기본 3001)\n"
+      << "  --delay D         : 명령 처리 지연 (예: 2ms, 기본 0)\n"
+      << "  --jitter D        : 추가 지연 [0, D] 균등 분포 (기본 0)\n"
+      << "  --no-batch        : X-Kulgad-Caps: batch 광고 안 함\n"
+      << "  --no-binary       : 바이너리 subprotocol(kulgad.bin.v1) 제안을 받아들이지 않음\n"
+      << "  --push            : 핀 변경 시 다른 연결에 상태 push\n"
+      << "  --drop P          : 채널별 set 을 확률 P(0~1)로 조용히 무시 (--verify 확인용)\n"
+      << "  --channels N      : 핀 수 (기본 256, 최대 65536). 256 단위로 bank 를 나눈다\n"
+      << "  --quiet           : 수신 로그 끔\n";
+}
+
+int main(int argc, char** argv){
+    try{
+        MockOptions opt;
+        for(int i=1;i<argc;++i){
+            std::string tok = argv[i];
+            auto value = [&]() -> const char* {
+                if(i+1>=argc){ std::cerr<<"Missing value for "<<tok<<"\n"; std::exit(1); }
+                return argv[++i];
+            };
+            if(tok=="--address") opt.address = value();
+            else if(tok=="--port") opt.port = static_cast<unsigned short>(std::atoi(value()));
+            else if(tok=="--delay" || tok=="--jitter"){
+                if(!parse_duration(value(), tok=="--delay" ? opt.delay : opt.jitter)){
+                    std::cerr<<"Invalid value for "<<tok<<": "<<argv[i]<<"\n";
+                    return 1;
+                }
+            }
+            else if(tok=="--drop") opt.drop = std::min(1.0, std::max(0.0, std::atof(value())));
+            else if(tok=="--channels"){
+                opt.channels = std::atoi(value());
+                if(opt.channels<1 || opt.channels>kMaxChannels){
+                    std::cerr<<"Invalid value for "<<tok<<": "<<argv[i]<<"\n";
+                    return 1;
+                }
+            }
+            else if(tok=="--no-batch") opt.batch = false;
+            else if(tok=="--no-binary") opt.binary = false;
+            else if(tok=="--push") opt.push = true;
+            else if(tok=="--quiet") opt.quiet = true;
+            else{ usage(); return 1; }
+        }
+
+        net::io_context ioc;
+        Controller ctl;
+        ctl.opt = opt;
+        ctl.pins.assign(opt.channels, false);
+        tcp::acceptor acceptor{ioc, {net::ip::make_address(opt.address), opt.port}};
+        accept_loop(acceptor, ctl);
+
+        net::signal_set signals{ioc, SIGINT, SIGTERM};
+        signals.async_wait([&](beast::error_code, int){ ioc.stop(); });
+
+        std::cout << "kulgad-mock listening on " << opt.address << ":" << opt.port << "\n" << std::flush;
+        ioc.run();
+        std::cout << "commands handled: " << ctl.commands << "\n";
+        return 0;
+
+    }catch(const std::exception& e){
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}